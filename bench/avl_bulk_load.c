@@ -0,0 +1,57 @@
+#include "../src/SL.h"
+
+
+#define KEYS (4 * 1000 * 1000)
+
+
+static double now_seconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+int main() {
+    int64_t *keys = (int64_t*) malloc(KEYS * sizeof(int64_t));
+    size_t *values = (size_t*) malloc(KEYS * sizeof(size_t));
+    void **data = (void**) malloc(KEYS * sizeof(void*));
+
+    if (!keys || !values || !data)
+        throw_memory_allocation_error();
+
+    for (size_t i=0; i<KEYS; ++i) {
+        keys[i] = (int64_t) i * 2;
+        values[i] = i;
+        data[i] = &values[i];
+    }
+
+    AVL_Tree *tree = New_AVL_Tree();
+    double start = now_seconds();
+
+    for (size_t i=0; i<KEYS; ++i)
+        tree->insert(tree, keys[i], data[i], sizeof(size_t));
+
+    double sequential = now_seconds() - start;
+    int sequential_height = tree->root->height;
+
+    tree->free(tree);
+
+    tree = New_AVL_Tree();
+    start = now_seconds();
+
+    if (!tree->load_sorted(tree, keys, data, sizeof(size_t), KEYS))
+        return EXIT_FAILURE;
+
+    double bulk = now_seconds() - start;
+
+    printf("%14s %10s %8s\n", "", "seconds", "height");
+    printf("%14s %10.3f %8d\n", "insert loop", sequential, sequential_height);
+    printf("%14s %10.3f %8d  (%.1fx)\n", "load_sorted", bulk, tree->root->height, sequential / bulk);
+
+    tree->free(tree);
+    free(keys);
+    free(values);
+    free(data);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,112 @@
+#include "../src/SL.h"
+
+#include <time.h>
+
+
+#define KEYS 1000000
+#define OPS_PER_THREAD 500000
+#define WRITE_PERCENT 10
+
+
+typedef struct bench_args {
+    AVL_Tree *tree;
+    pthread_mutex_t *serialize;
+    unsigned seed;
+} bench_args;
+
+
+static double now_seconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+static void* bench_worker(void *arg) {
+    bench_args *args = (bench_args*) arg;
+    AVL_Tree *tree = args->tree;
+    unsigned seed = args->seed;
+    size_t value;
+
+    for (size_t i=0; i<OPS_PER_THREAD; ++i) {
+        int64_t key = rand_r(&seed) % KEYS;
+        bool write = (unsigned) rand_r(&seed) % 100 < WRITE_PERCENT;
+
+        if (args->serialize)
+            LOCK(*args->serialize);
+
+        if (write && (i & 1))
+            tree->delete(tree, key);
+        else if (write)
+            tree->insert(tree, key, &i, sizeof(i));
+        else
+            tree->lookup(tree, key, &value, sizeof(value));
+
+        if (args->serialize)
+            UNLOCK(*args->serialize);
+    }
+
+    return NULL;
+}
+
+
+static double bench_run(AVL_Tree *tree, pthread_mutex_t *serialize, size_t threads) {
+    pthread_t *ids = (pthread_t*) malloc(threads * sizeof(pthread_t));
+    bench_args *args = (bench_args*) malloc(threads * sizeof(bench_args));
+
+    if (!ids || !args)
+        throw_memory_allocation_error();
+
+    double start = now_seconds();
+
+    for (size_t i=0; i<threads; ++i) {
+        args[i] = (bench_args) { tree, serialize, (unsigned) (i + 1) * 7919 };
+        pthread_create(&ids[i], NULL, bench_worker, &args[i]);
+    }
+
+    for (size_t i=0; i<threads; ++i)
+        pthread_join(ids[i], NULL);
+
+    double elapsed = now_seconds() - start;
+
+    free(ids);
+    free(args);
+
+    return (double) threads * OPS_PER_THREAD / elapsed / 1e6;
+}
+
+
+int main(int argc, char **argv) {
+    size_t max_threads = argc > 1 ? strtoul(argv[1], NULL, 10) : 8;
+
+    int64_t *keys = (int64_t*) malloc(KEYS * sizeof(int64_t));
+
+    if (!keys)
+        throw_memory_allocation_error();
+
+    for (size_t i=0; i<KEYS; ++i)
+        keys[i] = (int64_t) i;
+
+    pthread_mutex_t serialize;
+    pthread_mutex_init(&serialize, NULL);
+
+    printf("online cpus: %ld, %d%% writes\n", sysconf(_SC_NPROCESSORS_ONLN), WRITE_PERCENT);
+    printf("%8s %20s %20s\n", "threads", "mutex Mops/s", "rwlock Mops/s");
+
+    for (size_t threads=1; threads<=max_threads; threads*=2) {
+        AVL_Tree *tree = New_AVL_Tree();
+        tree->load_sorted(tree, keys, NULL, 0, KEYS);
+
+        double serialized = bench_run(tree, &serialize, threads);
+        double shared = bench_run(tree, NULL, threads);
+
+        printf("%8zu %20.2f %20.2f\n", threads, serialized, shared);
+
+        tree->free(tree);
+    }
+
+    pthread_mutex_destroy(&serialize);
+    free(keys);
+
+    return 0;
+}
@@ -0,0 +1,62 @@
+#include "../src/SL.h"
+
+
+#define KEYS (1000 * 1000)
+#define QUERIES 20
+
+
+static double now_seconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+static int64_t walk_select(AVL_Tree *tree, size_t k) {
+    AVLCursor cursor = AVL_CURSOR_INIT;
+    tree_node *node = tree->cursor_first(tree, &cursor);
+
+    while (node && k-- > 0)
+        node = tree->cursor_next(tree, &cursor);
+
+    tree->cursor_close(tree, &cursor);
+
+    return node ? node->key : -1;
+}
+
+
+int main() {
+    AVL_Tree *tree = New_AVL_Tree();
+    unsigned seed = 1;
+
+    for (size_t i=0; i<KEYS; ++i) {
+        int64_t latency = rand_r(&seed) % 1000000;
+        tree->insert(tree, latency * KEYS + (int64_t) i, NULL, 0);
+    }
+
+    size_t n = tree->size(tree);
+    int64_t checksum = 0;
+
+    double start = now_seconds();
+
+    for (size_t q=0; q<QUERIES; ++q)
+        checksum += walk_select(tree, n * q / QUERIES);
+
+    double walk = (now_seconds() - start) / QUERIES;
+
+    start = now_seconds();
+
+    for (size_t q=0; q<QUERIES; ++q)
+        checksum -= tree->select(tree, n * q / QUERIES)->key;
+
+    double select = (now_seconds() - start) / QUERIES;
+
+    printf("%12s %14s\n", "", "us/percentile");
+    printf("%12s %14.1f\n", "cursor walk", walk * 1e6);
+    printf("%12s %14.3f  (%.0fx)\n", "select", select * 1e6, walk / select);
+    printf("checksum %lld\n", (long long) checksum);
+
+    tree->free(tree);
+
+    return 0;
+}
@@ -0,0 +1,65 @@
+#include "../src/SL.h"
+
+
+#define MIN_KEYS 1000
+#define MAX_KEYS (10 * 1000 * 1000)
+#define SAMPLE_OPS (100 * 1000)
+
+
+static double now_seconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+static inline int scramble(size_t i) {
+    return (int) ((i * 2654435761u) & 0x7FFFFFFF);
+}
+
+
+int main() {
+    printf("%10s %14s %8s %14s %14s %14s %14s\n", "keys", "floor(log2 n)", "height", "insert ns/op", "lookup ns/op", "delete ns/op", "ns/op/log2(n)");
+
+    for (size_t n=MIN_KEYS; n<=MAX_KEYS; n*=10) {
+        AVL_Tree *tree = New_AVL_Tree();
+
+        for (size_t i=0; i<n; ++i)
+            tree->insert(tree, scramble(i), &i, sizeof(i));
+
+        size_t ops = MIN(n, SAMPLE_OPS);
+        unsigned seed = 12345;
+        size_t found = 0;
+
+        double start = now_seconds();
+
+        for (size_t i=0; i<ops; ++i)
+            tree->insert(tree, scramble(n + i), &i, sizeof(i));
+
+        double insert = (now_seconds() - start) * 1e9 / ops;
+
+        start = now_seconds();
+
+        for (size_t i=0; i<ops; ++i)
+            found += tree->lookup(tree, scramble(rand_r(&seed) % n), NULL, 0);
+
+        double lookup = (now_seconds() - start) * 1e9 / ops;
+
+        start = now_seconds();
+
+        for (size_t i=0; i<ops; ++i)
+            tree->delete(tree, scramble(n + i));
+
+        double delete = (now_seconds() - start) * 1e9 / ops;
+        double depth = 63 - __builtin_clzll(n);
+
+        printf("%10zu %14.0f %8d %14.1f %14.1f %14.1f %14.1f\n", n, depth, tree->root->height, insert, lookup, delete, (insert + lookup + delete) / 3 / depth);
+
+        tree->free(tree);
+
+        if (found != ops)
+            return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,102 @@
+#include "../src/SL.h"
+
+#include <time.h>
+
+
+#define KEYS (1000 * 1000)
+#define WRITER_OPS 200000
+
+
+typedef struct bench_args {
+    AVL_Tree *tree;
+    bool snapshot;
+    bool stop;
+    size_t scans;
+} bench_args;
+
+
+static double now_seconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+static void count_key(int64_t key, void *data, va_list args) {
+    (void) key;
+    (void) data;
+    (*va_arg(args, size_t*))++;
+}
+
+
+static void* scan_worker(void *arg) {
+    bench_args *args = (bench_args*) arg;
+    AVL_Tree *tree = args->tree;
+
+    while (!__atomic_load_n(&args->stop, __ATOMIC_ACQUIRE)) {
+        size_t seen = 0;
+
+        if (args->snapshot) {
+            AVLSnapshot *snapshot = tree->snapshot(tree);
+            snapshot->range(snapshot, INT64_MIN, INT64_MAX, count_key, &seen);
+            snapshot->free(snapshot);
+        } else {
+            tree->range(tree, INT64_MIN, INT64_MAX, count_key, &seen);
+        }
+
+        args->scans++;
+    }
+
+    return NULL;
+}
+
+
+static void bench_run(bool snapshot) {
+    AVL_Tree *tree = New_AVL_Tree();
+
+    if (snapshot)
+        tree->use_persistent(tree);
+
+    for (int64_t i=0; i<KEYS; ++i)
+        tree->insert(tree, i * 2, &i, sizeof(i));
+
+    bench_args args = { tree, snapshot, false, 0 };
+    pthread_t scanner;
+    pthread_create(&scanner, NULL, scan_worker, &args);
+
+    unsigned seed = 1;
+    double worst = 0;
+    double start = now_seconds();
+
+    for (size_t i=0; i<WRITER_OPS; ++i) {
+        int64_t key = (rand_r(&seed) % KEYS) * 2 + 1;
+        double op_start = now_seconds();
+
+        if (i & 1)
+            tree->delete(tree, key);
+        else
+            tree->insert(tree, key, &key, sizeof(key));
+
+        worst = MAX(worst, now_seconds() - op_start);
+    }
+
+    double elapsed = now_seconds() - start;
+
+    __atomic_store_n(&args.stop, true, __ATOMIC_RELEASE);
+    pthread_join(scanner, NULL);
+
+    printf("%10s %18.0f %18.1f %10zu\n", snapshot ? "snapshot" : "locked", WRITER_OPS / elapsed, worst * 1e3, args.scans);
+
+    tree->free(tree);
+}
+
+
+int main() {
+    printf("online cpus: %ld\n", sysconf(_SC_NPROCESSORS_ONLN));
+    printf("%10s %18s %18s %10s\n", "scan", "writer ops/s", "worst write ms", "scans");
+
+    bench_run(false);
+    bench_run(true);
+
+    return 0;
+}
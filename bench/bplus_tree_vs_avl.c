@@ -0,0 +1,79 @@
+#include "../src/SL.h"
+
+
+#define KEYS (1000 * 1000)
+#define LOOKUPS (1000 * 1000)
+
+
+static double now_seconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+static inline int scramble(size_t i) {
+    return (int) ((i * 2654435761u) & 0x7FFFFFFF);
+}
+
+
+static void count_visit(int64_t key, void *data, va_list args) {
+    size_t *count = va_arg(args, size_t*);
+    (void) key;
+    (void) data;
+    (*count)++;
+}
+
+
+int main() {
+    size_t found = 0;
+    unsigned seed = 12345;
+
+    double start = now_seconds();
+    AVL_Tree *avl = New_AVL_Tree();
+
+    for (size_t i=0; i<KEYS; ++i)
+        avl->insert(avl, scramble(i), &i, sizeof(i));
+
+    double avl_insert = (now_seconds() - start) * 1e9 / KEYS;
+
+    start = now_seconds();
+
+    for (size_t i=0; i<LOOKUPS; ++i)
+        found += avl->lookup(avl, scramble(rand_r(&seed) % KEYS), NULL, 0);
+
+    double avl_lookup = (now_seconds() - start) * 1e9 / LOOKUPS;
+
+    avl->free(avl);
+
+    start = now_seconds();
+    BPlusTree *tree = New_BPlusTree();
+
+    for (size_t i=0; i<KEYS; ++i)
+        tree->insert(tree, scramble(i), &i, sizeof(i));
+
+    double bpt_insert = (now_seconds() - start) * 1e9 / KEYS;
+
+    seed = 12345;
+    start = now_seconds();
+
+    for (size_t i=0; i<LOOKUPS; ++i)
+        found += tree->lookup(tree, scramble(rand_r(&seed) % KEYS)) != NULL;
+
+    double bpt_lookup = (now_seconds() - start) * 1e9 / LOOKUPS;
+
+    size_t scanned = 0;
+    start = now_seconds();
+
+    tree->range(tree, INT32_MIN, INT32_MAX, count_visit, &scanned);
+
+    double bpt_scan = (now_seconds() - start) * 1e9 / KEYS;
+
+    tree->free(tree);
+
+    printf("%12s %14s %14s %14s\n", "", "insert ns/op", "lookup ns/op", "scan ns/key");
+    printf("%12s %14.1f %14.1f %14s\n", "AVL_Tree", avl_insert, avl_lookup, "-");
+    printf("%12s %14.1f %14.1f %14.1f\n", "BPlusTree", bpt_insert, bpt_lookup, bpt_scan);
+
+    return found != 2 * LOOKUPS || scanned != KEYS;
+}
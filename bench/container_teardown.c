@@ -0,0 +1,68 @@
+#include "../src/SL.h"
+
+
+#define ELEMENTS (4 * 1000 * 1000)
+
+
+static double now_seconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+static inline int scramble(size_t i) {
+    return (int) ((i * 2654435761u) & 0x7FFFFFFF);
+}
+
+
+static void bench_tree(bool arena) {
+    AVL_Tree *tree = New_AVL_Tree();
+
+    if (arena)
+        tree->use_arena(tree);
+
+    double start = now_seconds();
+
+    for (size_t i=0; i<ELEMENTS; ++i)
+        tree->insert(tree, scramble(i), &i, sizeof(i));
+
+    double build = now_seconds() - start;
+
+    start = now_seconds();
+    tree->free(tree);
+
+    printf("%-18s %10.3f %10.3f\n", arena ? "AVL_Tree arena" : "AVL_Tree", build, now_seconds() - start);
+}
+
+
+static void bench_list(bool arena) {
+    List *list = New_List();
+
+    if (arena)
+        list->use_arena(list);
+
+    double start = now_seconds();
+
+    for (size_t i=0; i<ELEMENTS; ++i)
+        list->push(list, &i, sizeof(i));
+
+    double build = now_seconds() - start;
+
+    start = now_seconds();
+    list->free(list);
+
+    printf("%-18s %10.3f %10.3f\n", arena ? "List arena" : "List", build, now_seconds() - start);
+}
+
+
+int main() {
+    printf("%-18s %10s %10s   (seconds, %d elements)\n", "", "build", "free", ELEMENTS);
+
+    bench_tree(false);
+    bench_tree(true);
+    bench_list(false);
+    bench_list(true);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,71 @@
+#include "../src/SL.h"
+
+
+#define KEYS (4 * 1000 * 1000)
+#define LOOKUPS (4 * 1000 * 1000)
+#define KEY_LEN 24
+
+
+static double now_seconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+int main() {
+    static const size_t batch_sizes[] = { 64, 256, 1024 };
+
+    char (*storage)[KEY_LEN] = malloc(KEYS * sizeof(*storage));
+    char **keys = (char**) malloc(KEYS * sizeof(char*));
+    char **queries = (char**) malloc(LOOKUPS * sizeof(char*));
+    void **results = (void**) malloc(LOOKUPS * sizeof(void*));
+
+    if (!storage || !keys || !queries || !results)
+        throw_memory_allocation_error();
+
+    HashTable *table = New_HashTable();
+
+    for (size_t i=0; i<KEYS; ++i) {
+        snprintf(storage[i], KEY_LEN, "batch-key-%zu", i);
+        keys[i] = storage[i];
+        table->set(table, keys[i], &i, sizeof(i));
+    }
+
+    unsigned seed = 12345;
+
+    for (size_t i=0; i<LOOKUPS; ++i)
+        queries[i] = keys[rand_r(&seed) % KEYS];
+
+    size_t found = 0;
+    double start = now_seconds();
+
+    for (size_t i=0; i<LOOKUPS; ++i)
+        found += table->get(table, queries[i]) != NULL;
+
+    double single = LOOKUPS / (now_seconds() - start) / 1e6;
+
+    printf("%12s %12.2f Mops/s\n", "get loop", single);
+
+    for (size_t b=0; b<sizeof(batch_sizes) / sizeof(batch_sizes[0]); ++b) {
+        start = now_seconds();
+
+        for (size_t i=0; i<LOOKUPS; i+=batch_sizes[b])
+            table->get_many(table, queries + i, MIN(batch_sizes[b], LOOKUPS - i), results + i);
+
+        double batched = LOOKUPS / (now_seconds() - start) / 1e6;
+
+        for (size_t i=0; i<LOOKUPS; ++i)
+            found += results[i] != NULL;
+
+        printf("get_many %4zu %12.2f Mops/s  (%.2fx)\n", batch_sizes[b], batched, batched / single);
+    }
+
+    table->free(table);
+    free(storage);
+    free(keys);
+    free(queries);
+    free(results);
+
+    return found == 0;
+}
@@ -0,0 +1,115 @@
+#include "../src/SL.h"
+
+#include <time.h>
+
+
+#define KEYS 1000000
+#define OPS_PER_THREAD 2000000
+#define KEY_LEN 24
+
+
+typedef struct bench_args {
+    void *table;
+    bool concurrent;
+    char (*keys)[KEY_LEN];
+    unsigned seed;
+} bench_args;
+
+
+static double now_seconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+static void* bench_worker(void *arg) {
+    bench_args *args = (bench_args*) arg;
+    unsigned seed = args->seed;
+
+    for (size_t i=0; i<OPS_PER_THREAD; ++i) {
+        char *key = args->keys[rand_r(&seed) % KEYS];
+        size_t value = i;
+
+        if (args->concurrent) {
+            ConcurrentHashTable *table = (ConcurrentHashTable*) args->table;
+
+            if (i & 1)
+                table->set(table, key, &value, sizeof(value));
+            else
+                table->get(table, key);
+        } else {
+            HashTable *table = (HashTable*) args->table;
+
+            if (i & 1)
+                table->set(table, key, &value, sizeof(value));
+            else
+                table->get(table, key);
+        }
+    }
+
+    return NULL;
+}
+
+
+static double bench_run(void *table, bool concurrent, char (*keys)[KEY_LEN], size_t threads) {
+    pthread_t *ids = (pthread_t*) malloc(threads * sizeof(pthread_t));
+    bench_args *args = (bench_args*) malloc(threads * sizeof(bench_args));
+
+    if (!ids || !args)
+        throw_memory_allocation_error();
+
+    double start = now_seconds();
+
+    for (size_t i=0; i<threads; ++i) {
+        args[i] = (bench_args) { table, concurrent, keys, (unsigned) (i + 1) * 7919 };
+        pthread_create(&ids[i], NULL, bench_worker, &args[i]);
+    }
+
+    for (size_t i=0; i<threads; ++i)
+        pthread_join(ids[i], NULL);
+
+    double elapsed = now_seconds() - start;
+
+    free(ids);
+    free(args);
+
+    return (double) threads * OPS_PER_THREAD / elapsed / 1e6;
+}
+
+
+int main(int argc, char **argv) {
+    size_t max_threads = argc > 1 ? strtoul(argv[1], NULL, 10) : 8;
+
+    char (*keys)[KEY_LEN] = malloc(KEYS * sizeof(*keys));
+
+    if (!keys)
+        throw_memory_allocation_error();
+
+    for (size_t i=0; i<KEYS; ++i)
+        snprintf(keys[i], KEY_LEN, "ingest-key-%zu", i);
+
+    printf("%8s %20s %20s\n", "threads", "HashTable Mops/s", "Concurrent Mops/s");
+
+    for (size_t threads=1; threads<=max_threads; threads*=2) {
+        HashTable *table = New_HashTable();
+        ConcurrentHashTable *concurrent = New_ConcurrentHashTable();
+
+        for (size_t i=0; i<KEYS; ++i) {
+            table->set(table, keys[i], &i, sizeof(i));
+            concurrent->set(concurrent, keys[i], &i, sizeof(i));
+        }
+
+        double single = bench_run(table, false, keys, threads);
+        double sharded = bench_run(concurrent, true, keys, threads);
+
+        printf("%8zu %20.2f %20.2f\n", threads, single, sharded);
+
+        table->free(table);
+        concurrent->free(concurrent);
+    }
+
+    free(keys);
+
+    return 0;
+}
@@ -0,0 +1,76 @@
+#include "../src/SL.h"
+
+
+#define KEYS (4 * 1000 * 1000)
+#define LOOKUPS (100 * 1000)
+#define KEY_LEN 24
+#define SNAPSHOT_PATH "./hash_table_snapshot.bin"
+
+
+static double now_seconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+int main() {
+    char key[KEY_LEN];
+    double start = now_seconds();
+
+    HashTable *table = New_HashTable();
+
+    for (size_t i=0; i<KEYS; ++i) {
+        snprintf(key, KEY_LEN, "snapshot-key-%zu", i);
+        table->set(table, key, &i, sizeof(i));
+    }
+
+    double rebuild = now_seconds() - start;
+
+    start = now_seconds();
+
+    if (!table->save(table, SNAPSHOT_PATH)) {
+        fprintf(stderr, "Could not write snapshot\n");
+        return EXIT_FAILURE;
+    }
+
+    double save = now_seconds() - start;
+
+    table->free(table);
+
+    start = now_seconds();
+
+    HashTableSnapshot *snapshot = New_HashTableSnapshot(SNAPSHOT_PATH);
+
+    if (!snapshot) {
+        fprintf(stderr, "Could not open snapshot\n");
+        return EXIT_FAILURE;
+    }
+
+    double open = now_seconds() - start;
+
+    unsigned seed = 12345;
+    size_t found = 0;
+
+    start = now_seconds();
+
+    for (size_t i=0; i<LOOKUPS; ++i) {
+        size_t k = rand_r(&seed) % KEYS;
+        snprintf(key, KEY_LEN, "snapshot-key-%zu", k);
+
+        size_t *value = (size_t*) snapshot->get(snapshot, key);
+        found += value && *value == k;
+    }
+
+    double lookups = now_seconds() - start;
+
+    printf("%24s %10.3f s\n", "rebuild via set", rebuild);
+    printf("%24s %10.3f s\n", "save", save);
+    printf("%24s %10.3f s\n", "open snapshot", open);
+    printf("%24s %10.3f s  (%zu found)\n", "first lookups", lookups, found);
+
+    snapshot->free(snapshot);
+    remove(SNAPSHOT_PATH);
+
+    return found != LOOKUPS;
+}
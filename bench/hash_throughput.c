@@ -0,0 +1,75 @@
+#include "../src/SL.h"
+
+
+#define BUFFER_SIZE (1 << 20)
+#define BYTES_PER_RUN (1ULL << 30)
+
+
+typedef uint64_t (*hash_function)(const void *key, size_t len, uint64_t seed);
+
+
+static double now_seconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+static uint64_t hash_fnv1a_unseeded(const void *key, size_t len, uint64_t seed) {
+    (void) seed;
+    return fnv1a_64(key, len);
+}
+
+
+static double bench_hash(hash_function func, const uint8_t *buffer, size_t key_size, uint64_t *sink) {
+    size_t keys = BUFFER_SIZE / key_size;
+    size_t rounds = BYTES_PER_RUN / (keys * key_size);
+    uint64_t acc = 0;
+
+    double start = now_seconds();
+
+    for (size_t r=0; r<rounds; ++r)
+        for (size_t i=0; i<keys; ++i)
+            acc += func(buffer + i * key_size, key_size, acc);
+
+    double elapsed = now_seconds() - start;
+
+    *sink ^= acc;
+
+    return (double) rounds * keys * key_size / elapsed / 1e9;
+}
+
+
+int main() {
+    static const size_t sizes[] = { 8, 16, 32, 64, 128, 256, 1024 };
+    static const char *names[] = { "fnv1a_64", "murmur64a", "wyhash" };
+    hash_function functions[] = { hash_fnv1a_unseeded, hash_murmur64a, hash_wyhash };
+
+    uint8_t *buffer = (uint8_t*) malloc(BUFFER_SIZE);
+
+    if (!buffer)
+        throw_memory_allocation_error();
+
+    for (size_t i=0; i<BUFFER_SIZE; ++i)
+        buffer[i] = (uint8_t) (i * 131 + (i >> 7));
+
+    uint64_t sink = 0;
+
+    printf("%10s", "key bytes");
+    for (size_t f=0; f<3; ++f)
+        printf(" %12s", names[f]);
+    printf("   (GB/s)\n");
+
+    for (size_t s=0; s<sizeof(sizes) / sizeof(sizes[0]); ++s) {
+        printf("%10zu", sizes[s]);
+
+        for (size_t f=0; f<3; ++f)
+            printf(" %12.2f", bench_hash(functions[f], buffer, sizes[s], &sink));
+
+        printf("\n");
+    }
+
+    free(buffer);
+
+    return sink == 42;
+}
@@ -0,0 +1,124 @@
+#include "../src/SL.h"
+
+#include <malloc.h>
+
+
+#define IDS (1000 * 1000)
+#define ID_SPACE (2 * IDS)
+
+
+static double now_seconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+static size_t heap_in_use() {
+    struct mallinfo2 info = mallinfo2();
+
+    return info.uordblks + info.hblkhd;
+}
+
+
+static void report(const char *name, size_t bytes, double insert, double lookup, size_t found) {
+    printf("%18s %12.2f %12.0f %12.0f %10zu\n", name, bytes * 8.0 / IDS, insert / IDS * 1e9, lookup / ID_SPACE * 1e9, found);
+}
+
+
+static void bench_set(const uint32_t *ids) {
+    size_t before = heap_in_use();
+    size_t found = 0;
+    Set *set = New_Set();
+
+    double start = now_seconds();
+
+    for (size_t i=0; i<IDS; ++i)
+        set->insert(set, (void*) &ids[i], sizeof(uint32_t));
+
+    double insert = now_seconds() - start;
+    size_t bytes = heap_in_use() - before;
+
+    start = now_seconds();
+
+    for (uint32_t id=0; id<ID_SPACE; ++id)
+        found += set->lookup(set, &id, sizeof(id));
+
+    double lookup = now_seconds() - start;
+
+    report("Set", bytes, insert, lookup, found);
+
+    set->free(set);
+}
+
+
+static void bench_int_set(const uint32_t *ids, bool bulk, bool optimize) {
+    size_t found = 0;
+    IntSet *set = New_IntSet();
+
+    double start = now_seconds();
+
+    if (bulk) {
+        set->insert_many(set, ids, IDS);
+    } else {
+        for (size_t i=0; i<IDS; ++i)
+            set->insert(set, ids[i]);
+    }
+
+    if (optimize)
+        set->optimize(set);
+
+    double insert = now_seconds() - start;
+
+    start = now_seconds();
+
+    for (uint32_t id=0; id<ID_SPACE; ++id)
+        found += set->lookup(set, id);
+
+    double lookup = now_seconds() - start;
+
+    report(bulk ? (optimize ? "IntSet bulk+opt" : "IntSet bulk") : "IntSet", set->memory_usage(set), insert, lookup, found);
+
+    set->free(set);
+}
+
+
+int main() {
+    uint32_t *ids = (uint32_t*) malloc(IDS * sizeof(uint32_t));
+
+    if (!ids)
+        throw_memory_allocation_error();
+
+    unsigned seed = 42;
+
+    printf("random ids, %d of %d\n", IDS, ID_SPACE);
+    printf("%18s %12s %12s %12s %10s\n", "", "bits/id", "insert ns", "lookup ns", "found");
+
+    for (size_t i=0; i<IDS; ++i)
+        ids[i] = 2 * i + (rand_r(&seed) & 1);
+
+    for (size_t i=IDS - 1; i>0; --i) {
+        size_t j = rand_r(&seed) % (i + 1);
+        uint32_t tmp = ids[i];
+        ids[i] = ids[j];
+        ids[j] = tmp;
+    }
+
+    bench_set(ids);
+    bench_int_set(ids, false, false);
+    bench_int_set(ids, true, false);
+
+    printf("\nsequential ids, %d of %d\n", IDS, ID_SPACE);
+    printf("%18s %12s %12s %12s %10s\n", "", "bits/id", "insert ns", "lookup ns", "found");
+
+    for (size_t i=0; i<IDS; ++i)
+        ids[i] = (uint32_t) i;
+
+    bench_set(ids);
+    bench_int_set(ids, false, false);
+    bench_int_set(ids, true, true);
+
+    free(ids);
+
+    return 0;
+}
@@ -0,0 +1,214 @@
+#include "../src/SL.h"
+
+#include <time.h>
+
+
+#define LARGE (1000 * 1000)
+#define SMALL (10 * 1000)
+
+
+static double now_seconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+static void set_copy_into(void *data, size_t type_size, va_list args) {
+    Set *target = va_arg(args, Set*);
+
+    target->insert(target, data, type_size);
+}
+
+
+static void set_keep_common(void *data, size_t type_size, va_list args) {
+    Set *probe = va_arg(args, Set*);
+    Set *target = va_arg(args, Set*);
+
+    if (probe->lookup(probe, data, type_size))
+        target->insert(target, data, type_size);
+}
+
+
+static void set_keep_missing(void *data, size_t type_size, va_list args) {
+    Set *probe = va_arg(args, Set*);
+    Set *target = va_arg(args, Set*);
+
+    if (!probe->lookup(probe, data, type_size))
+        target->insert(target, data, type_size);
+}
+
+
+static void int_set_copy_into(uint32_t value, va_list args) {
+    IntSet *target = va_arg(args, IntSet*);
+
+    target->insert(target, value);
+}
+
+
+static void int_set_keep_common(uint32_t value, va_list args) {
+    IntSet *probe = va_arg(args, IntSet*);
+    IntSet *target = va_arg(args, IntSet*);
+
+    if (probe->lookup(probe, value))
+        target->insert(target, value);
+}
+
+
+static void int_set_keep_missing(uint32_t value, va_list args) {
+    IntSet *probe = va_arg(args, IntSet*);
+    IntSet *target = va_arg(args, IntSet*);
+
+    if (!probe->lookup(probe, value))
+        target->insert(target, value);
+}
+
+
+static Set* build_set(uint64_t first, size_t n, uint64_t step) {
+    Set *set = New_Set();
+
+    for (size_t i=0; i<n; ++i) {
+        uint64_t id = first + i * step;
+        set->insert(set, &id, sizeof(id));
+    }
+
+    return set;
+}
+
+
+static IntSet* build_int_set(uint32_t first, size_t n, uint32_t step) {
+    IntSet *set = New_IntSet();
+
+    for (size_t i=0; i<n; ++i)
+        set->insert(set, first + (uint32_t) (i * step));
+
+    return set;
+}
+
+
+static void bench_set(const char *name, Set *a, Set *b) {
+    double manual[3], native[3];
+    size_t sizes[3];
+    Set *out;
+
+    double start = now_seconds();
+    out = New_Set();
+    a->foreach(a, set_copy_into, out);
+    b->foreach(b, set_copy_into, out);
+    manual[0] = now_seconds() - start;
+    out->free(out);
+
+    start = now_seconds();
+    out = New_Set();
+    a->foreach(a, set_keep_common, b, out);
+    manual[1] = now_seconds() - start;
+    out->free(out);
+
+    start = now_seconds();
+    out = New_Set();
+    a->foreach(a, set_keep_missing, b, out);
+    manual[2] = now_seconds() - start;
+    out->free(out);
+
+    start = now_seconds();
+    out = a->unite(a, b);
+    native[0] = now_seconds() - start;
+    sizes[0] = out->size(out);
+    out->free(out);
+
+    start = now_seconds();
+    out = a->intersect(a, b);
+    native[1] = now_seconds() - start;
+    sizes[1] = out->size(out);
+    out->free(out);
+
+    start = now_seconds();
+    out = a->subtract(a, b);
+    native[2] = now_seconds() - start;
+    sizes[2] = out->size(out);
+    out->free(out);
+
+    printf("%-24s %9.1f/%-9.1f %9.1f/%-9.1f %9.1f/%-9.1f   (%zu, %zu, %zu)\n", name,
+           manual[0] * 1e3, native[0] * 1e3, manual[1] * 1e3, native[1] * 1e3, manual[2] * 1e3, native[2] * 1e3,
+           sizes[0], sizes[1], sizes[2]);
+}
+
+
+static void bench_int_set(const char *name, IntSet *a, IntSet *b) {
+    double manual[3], native[3];
+    size_t sizes[3];
+    IntSet *out;
+
+    double start = now_seconds();
+    out = New_IntSet();
+    a->foreach(a, int_set_copy_into, out);
+    b->foreach(b, int_set_copy_into, out);
+    manual[0] = now_seconds() - start;
+    out->free(out);
+
+    start = now_seconds();
+    out = New_IntSet();
+    a->foreach(a, int_set_keep_common, b, out);
+    manual[1] = now_seconds() - start;
+    out->free(out);
+
+    start = now_seconds();
+    out = New_IntSet();
+    a->foreach(a, int_set_keep_missing, b, out);
+    manual[2] = now_seconds() - start;
+    out->free(out);
+
+    start = now_seconds();
+    out = a->unite(a, b);
+    native[0] = now_seconds() - start;
+    sizes[0] = out->size(out);
+    out->free(out);
+
+    start = now_seconds();
+    out = a->intersect(a, b);
+    native[1] = now_seconds() - start;
+    sizes[1] = out->size(out);
+    out->free(out);
+
+    start = now_seconds();
+    out = a->subtract(a, b);
+    native[2] = now_seconds() - start;
+    sizes[2] = out->size(out);
+    out->free(out);
+
+    printf("%-24s %9.1f/%-9.1f %9.1f/%-9.1f %9.1f/%-9.1f   (%zu, %zu, %zu)\n", name,
+           manual[0] * 1e3, native[0] * 1e3, manual[1] * 1e3, native[1] * 1e3, manual[2] * 1e3, native[2] * 1e3,
+           sizes[0], sizes[1], sizes[2]);
+}
+
+
+int main() {
+    printf("ms, hand-written loop / native\n");
+    printf("%-24s %19s %19s %19s\n", "", "union", "intersection", "difference");
+
+    Set *a = build_set(0, LARGE, 1);
+    Set *b = build_set(LARGE / 2, LARGE, 1);
+    Set *c = build_set(0, SMALL, 97);
+
+    bench_set("Set 1M x 1M", a, b);
+    bench_set("Set 1M x 10k", a, c);
+    bench_set("Set 10k x 1M", c, a);
+
+    a->free(a);
+    b->free(b);
+    c->free(c);
+
+    IntSet *x = build_int_set(0, LARGE, 2);
+    IntSet *y = build_int_set(LARGE, LARGE, 3);
+    IntSet *z = build_int_set(0, SMALL, 97);
+
+    bench_int_set("IntSet 1M x 1M", x, y);
+    bench_int_set("IntSet 1M x 10k", x, z);
+    bench_int_set("IntSet 10k x 1M", z, x);
+
+    x->free(x);
+    y->free(y);
+    z->free(z);
+
+    return 0;
+}
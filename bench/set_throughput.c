@@ -0,0 +1,61 @@
+#include "../src/SL.h"
+
+#include <time.h>
+
+
+#define ELEMENTS 1000000
+
+
+typedef struct element {
+    uint64_t id;
+    uint64_t tag;
+} element;
+
+
+static double now_seconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+int main() {
+    Set *set = New_Set();
+    element e = { 0, 0 };
+    size_t found = 0;
+
+    double start = now_seconds();
+
+    for (size_t i=0; i<ELEMENTS; ++i) {
+        e.id = i;
+        e.tag = i * 2654435761u;
+        set->insert(set, &e, sizeof(e));
+    }
+
+    double insert = now_seconds() - start;
+    start = now_seconds();
+
+    for (size_t i=0; i<2 * ELEMENTS; ++i) {
+        e.id = i;
+        e.tag = i * 2654435761u;
+        found += set->lookup(set, &e, sizeof(e));
+    }
+
+    double lookup = now_seconds() - start;
+    start = now_seconds();
+
+    for (size_t i=0; i<ELEMENTS; ++i) {
+        e.id = i;
+        e.tag = i * 2654435761u;
+        set->delete(set, &e, sizeof(e));
+    }
+
+    double delete = now_seconds() - start;
+
+    printf("%10s %10s %10s   (%zu of %d found)\n", "insert", "lookup", "delete", found, 2 * ELEMENTS);
+    printf("%7.0f ns %7.0f ns %7.0f ns\n", insert / ELEMENTS * 1e9, lookup / (2 * ELEMENTS) * 1e9, delete / ELEMENTS * 1e9);
+
+    set->free(set);
+
+    return 0;
+}
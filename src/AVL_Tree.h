@@ -2,48 +2,309 @@
 
 
 #include "./internals.h"
+#include "./Pool.h"
+#include "./Epoch.h"
+
+
+#define AVL_TREE_PARALLEL_THRESHOLD (1 << 16)
+#define AVL_CURSOR_INIT { NULL, 0, NULL, 0, 0, 0 }
+#define AVL_HELD_MAX 8
+#define AVL_CURSOR_DEPTH 96
 
 
 typedef struct tree_node {
-    int key;
-    void *data;
-    size_t type_size;
+    int64_t key;
 
-    struct tree_node *parent;
     struct tree_node *left;
     struct tree_node *right;
+    struct tree_node *parent;
+
+    void *data;
+    void *key_bytes;
+    size_t type_size;
+    size_t key_len;
+    size_t count;
+    int16_t height;
+    bool adopted;
+    bool key_shared;
+    uint32_t generation;
 } tree_node;
 
 
-typedef struct AVL_Tree {
-    struct AVL_Tree *self;
+typedef struct avl_key {
+    int64_t value;
+    const void *bytes;
+    size_t len;
+    bool is_bytes;
+} avl_key;
+
+
+typedef struct AVLCursor {
+    tree_node *node;
+    int64_t key;
+    char *key_bytes;
+    size_t key_len;
+    size_t key_capacity;
+    size_t version;
+    size_t depth;
+    tree_node *path[AVL_CURSOR_DEPTH];
+} AVLCursor;
+
+
+typedef struct avl_build_source {
+    tree_node *nodes;
+    char *values;
+    const int64_t *keys;
+    void **data;
+    size_t type_size;
+} avl_build_source;
 
+
+typedef struct avl_build_job {
+    const avl_build_source *source;
+    size_t lo;
+    size_t hi;
+    tree_node *parent;
+    int spawn_depth;
     tree_node *root;
+} avl_build_job;
+
+
+typedef int (*avl_comparator)(const void *a, size_t a_len, const void *b, size_t b_len);
+
 
-    pthread_mutex_t mutex;
-    pthread_mutexattr_t mutex_attr;
+typedef struct AVL_Tree {
+    struct AVL_Tree *self;
 
-    void (*insert)(struct AVL_Tree *self, int key, void *data, size_t type_size);
-    void (*delete)(struct AVL_Tree *self, int key);
-    tree_node* (*lookup)(struct AVL_Tree *self, int key);
+    tree_node *root;
+    size_t version;
+
+    bool byte_keys;
+    avl_comparator compare;
+
+    node_pool pool;
+    bool arena;
+    size_t adopted_count;
+    char *bulk;
+    size_t bulk_bytes;
+
+    bool persistent;
+    size_t snapshots;
+    uint64_t epoch;
+    uint32_t generation;
+    pthread_mutex_t snapshots_mutex;
+    struct AVLSnapshot *oldest;
+    struct AVLSnapshot *newest;
+    epoch_bag retired;
+
+    void (*destructor)(void *data);
+
+    pthread_rwlock_t lock;
+
+    void (*insert)(struct AVL_Tree *self, int64_t key, void *data, size_t type_size);
+    void (*insert_bytes)(struct AVL_Tree *self, const void *key, size_t key_len, void *data, size_t type_size);
+    void (*adopt)(struct AVL_Tree *self, int64_t key, void *data, size_t type_size);
+    void (*adopt_bytes)(struct AVL_Tree *self, const void *key, size_t key_len, void *data, size_t type_size);
+    bool (*load_sorted)(struct AVL_Tree *self, const int64_t *keys, void **data, size_t type_size, size_t n);
+    void (*delete)(struct AVL_Tree *self, int64_t key);
+    void (*delete_bytes)(struct AVL_Tree *self, const void *key, size_t key_len);
+    void* (*steal)(struct AVL_Tree *self, int64_t key);
+    void* (*steal_bytes)(struct AVL_Tree *self, const void *key, size_t key_len);
+    bool (*lookup)(struct AVL_Tree *self, int64_t key, void *out, size_t capacity);
+    bool (*lookup_bytes)(struct AVL_Tree *self, const void *key, size_t key_len, void *out, size_t capacity);
+    // lookup_node and the other tree_node* results are only safe to use between pin and unpin while other
+    // threads write. The lock is not recursive: insert, delete, steal and the setters called from inside
+    // pin/unpin or a range callback on the same tree exit with an error instead of deadlocking.
+    tree_node* (*lookup_node)(struct AVL_Tree *self, int64_t key);
+    tree_node* (*lookup_node_bytes)(struct AVL_Tree *self, const void *key, size_t key_len);
+    tree_node* (*min)(struct AVL_Tree *self);
+    tree_node* (*max)(struct AVL_Tree *self);
+    tree_node* (*floor)(struct AVL_Tree *self, int64_t key);
+    tree_node* (*floor_bytes)(struct AVL_Tree *self, const void *key, size_t key_len);
+    tree_node* (*ceiling)(struct AVL_Tree *self, int64_t key);
+    tree_node* (*ceiling_bytes)(struct AVL_Tree *self, const void *key, size_t key_len);
+    size_t (*rank)(struct AVL_Tree *self, int64_t key);
+    size_t (*rank_bytes)(struct AVL_Tree *self, const void *key, size_t key_len);
+    tree_node* (*select)(struct AVL_Tree *self, size_t k);
+    // count_range, count_range_bytes and range cover keys in [lo, hi), matching BPlusTree.
+    size_t (*count_range)(struct AVL_Tree *self, int64_t lo, int64_t hi);
+    size_t (*count_range_bytes)(struct AVL_Tree *self, const void *lo, size_t lo_len, const void *hi, size_t hi_len);
+    size_t (*size)(struct AVL_Tree *self);
+    void (*range)(struct AVL_Tree *self, int64_t lo, int64_t hi, void (*func)(int64_t key, void *data, va_list args), ...);
+    tree_node* (*cursor_first)(struct AVL_Tree *self, AVLCursor *cursor);
+    tree_node* (*cursor_last)(struct AVL_Tree *self, AVLCursor *cursor);
+    tree_node* (*cursor_seek)(struct AVL_Tree *self, AVLCursor *cursor, int64_t key);
+    tree_node* (*cursor_seek_bytes)(struct AVL_Tree *self, AVLCursor *cursor, const void *key, size_t key_len);
+    tree_node* (*cursor_next)(struct AVL_Tree *self, AVLCursor *cursor);
+    tree_node* (*cursor_prev)(struct AVL_Tree *self, AVLCursor *cursor);
+    void (*cursor_close)(struct AVL_Tree *self, AVLCursor *cursor);
+    bool (*set_comparator)(struct AVL_Tree *self, avl_comparator compare);
+    void (*set_destructor)(struct AVL_Tree *self, void (*destructor)(void *data));
+    bool (*use_arena)(struct AVL_Tree *self);
+    bool (*use_persistent)(struct AVL_Tree *self);
+    struct AVLSnapshot* (*snapshot)(struct AVL_Tree *self);
+    void (*pin)(struct AVL_Tree *self);
+    void (*unpin)(struct AVL_Tree *self);
     void (*free)(struct AVL_Tree *self);
 } AVL_Tree;
 
 
-AVL_Tree* New_AVL_Tree();
-static size_t tree_node_height(tree_node *node);
+typedef struct AVLSnapshot {
+    struct AVLSnapshot *self;
+
+    AVL_Tree *tree;
+    tree_node *root;
+
+    uint64_t epoch;
+    struct AVLSnapshot *prev;
+    struct AVLSnapshot *next;
+
+    tree_node* (*lookup)(struct AVLSnapshot *self, int64_t key);
+    tree_node* (*lookup_bytes)(struct AVLSnapshot *self, const void *key, size_t key_len);
+    tree_node* (*min)(struct AVLSnapshot *self);
+    tree_node* (*max)(struct AVLSnapshot *self);
+    tree_node* (*floor)(struct AVLSnapshot *self, int64_t key);
+    tree_node* (*floor_bytes)(struct AVLSnapshot *self, const void *key, size_t key_len);
+    tree_node* (*ceiling)(struct AVLSnapshot *self, int64_t key);
+    tree_node* (*ceiling_bytes)(struct AVLSnapshot *self, const void *key, size_t key_len);
+    size_t (*rank)(struct AVLSnapshot *self, int64_t key);
+    size_t (*rank_bytes)(struct AVLSnapshot *self, const void *key, size_t key_len);
+    tree_node* (*select)(struct AVLSnapshot *self, size_t k);
+    size_t (*count_range)(struct AVLSnapshot *self, int64_t lo, int64_t hi);
+    size_t (*count_range_bytes)(struct AVLSnapshot *self, const void *lo, size_t lo_len, const void *hi, size_t hi_len);
+    size_t (*size)(struct AVLSnapshot *self);
+    void (*range)(struct AVLSnapshot *self, int64_t lo, int64_t hi, void (*func)(int64_t key, void *data, va_list args), ...);
+    void (*free)(struct AVLSnapshot *self);
+} AVLSnapshot;
+
+
+__thread AVL_Tree *avl_held[AVL_HELD_MAX];
+__thread size_t avl_held_len = 0;
+
+
+static inline int tree_node_height(const tree_node *node);
+static inline void tree_node_update_height(tree_node *node);
+static inline size_t tree_node_count(const tree_node *node);
+static inline void tree_node_update_count(tree_node *node);
 static tree_node* tree_node_left_rotate(tree_node *node);
 static tree_node* tree_node_right_rotate(tree_node *node);
-static int8_t tree_node_balance(tree_node *node);
-static tree_node* init_avl_node(int key, void *data, size_t type_size);
-static tree_node* avl_insert_node(tree_node *node, int key, void *data, size_t type_size);
-static void avl_insert(AVL_Tree *self, int key, void *data, size_t type_size);
+static inline int tree_node_balance(const tree_node *node);
+static inline avl_key avl_int_key(int64_t value);
+static inline avl_key avl_bytes_key(const void *bytes, size_t len);
+static inline int avl_compare_bytes(const void *a, size_t a_len, const void *b, size_t b_len);
+static inline int avl_compare(const AVL_Tree *self, const avl_key *key, const tree_node *node);
+static inline void avl_check_key_type(const AVL_Tree *self, const avl_key *key);
+static inline void avl_hold(AVL_Tree *self);
+static inline void avl_release(AVL_Tree *self);
+static inline void avl_write_lock(AVL_Tree *self);
+static tree_node* init_avl_node(AVL_Tree *self, const avl_key *key, void *data, size_t type_size, bool adopted, bool key_shared);
+static inline void* avl_copy_data(AVL_Tree *self, const void *data, size_t type_size);
+static void avl_reclaim_node(void *ctx, void *node);
+static void avl_reclaim_adopted(void *ctx, void *data);
+static inline void avl_retire(AVL_Tree *self, void (*reclaim)(void *ctx, void *ptr), void *ptr);
+static inline bool avl_in_bulk(const AVL_Tree *self, const void *data);
+static inline void avl_release_data(AVL_Tree *self, void *data, bool adopted);
+static inline void avl_release_key(AVL_Tree *self, tree_node *node);
+static inline void avl_replace_child(AVL_Tree *self, tree_node *parent, tree_node *old_child, tree_node *new_child);
+static void avl_update_counts(tree_node *node);
+static void avl_rebalance(AVL_Tree *self, tree_node *node);
+static void avl_replace_data(AVL_Tree *self, tree_node *node, const avl_key *key, void *data, size_t type_size, bool adopted, bool key_shared);
+static void avl_path_reset_generation(tree_node *node);
+static inline void avl_path_begin(AVL_Tree *self);
+static tree_node* avl_path_copy(AVL_Tree *self, tree_node *node);
+static tree_node* avl_path_left_rotate(AVL_Tree *self, tree_node *node);
+static tree_node* avl_path_right_rotate(AVL_Tree *self, tree_node *node);
+static tree_node* avl_path_balance(AVL_Tree *self, tree_node *node);
+static tree_node* avl_path_insert(AVL_Tree *self, tree_node *node, const avl_key *key, void *data, size_t type_size, bool adopted, bool key_shared);
+static void avl_insert_data(AVL_Tree *self, const avl_key *key, void *data, size_t type_size, bool adopted, bool key_shared);
+static void avl_insert(AVL_Tree *self, int64_t key, void *data, size_t type_size);
+static void avl_insert_bytes(AVL_Tree *self, const void *key, size_t key_len, void *data, size_t type_size);
+static void avl_adopt(AVL_Tree *self, int64_t key, void *data, size_t type_size);
+static void avl_adopt_bytes(AVL_Tree *self, const void *key, size_t key_len, void *data, size_t type_size);
+static tree_node* avl_build_range(const avl_build_source *source, size_t lo, size_t hi, tree_node *parent, int spawn_depth);
+static void* avl_build_worker(void *arg);
+static bool avl_load_sorted(AVL_Tree *self, const int64_t *keys, void **data, size_t type_size, size_t n);
 static tree_node* get_min_node(tree_node* node);
-static tree_node* avl_delete_node(tree_node* node, int key);
-static void avl_delete(AVL_Tree *self, int key);
-static tree_node* avl_search_node(tree_node *node, int key);
-static inline tree_node* avl_lookup(struct AVL_Tree *self, int key);
-static void avl_free_subtree(tree_node *node);
+static tree_node* get_max_node(tree_node* node);
+static tree_node* avl_successor(tree_node *node);
+static tree_node* avl_predecessor(tree_node *node);
+static tree_node* avl_search_node(const AVL_Tree *self, tree_node *root, const avl_key *key);
+static tree_node* avl_bound_node(const AVL_Tree *self, tree_node *root, const avl_key *key, bool greater, bool inclusive);
+static tree_node* avl_path_remove_min(AVL_Tree *self, tree_node *node, tree_node **min);
+static tree_node* avl_path_remove(AVL_Tree *self, tree_node *node, const avl_key *key, tree_node *removed, bool *found);
+static bool avl_remove(AVL_Tree *self, const avl_key *key, tree_node *removed);
+static void avl_delete_key(AVL_Tree *self, const avl_key *key);
+static void avl_delete(AVL_Tree *self, int64_t key);
+static void avl_delete_bytes(AVL_Tree *self, const void *key, size_t key_len);
+static void* avl_steal_key(AVL_Tree *self, const avl_key *key);
+static void* avl_steal(AVL_Tree *self, int64_t key);
+static void* avl_steal_bytes(AVL_Tree *self, const void *key, size_t key_len);
+static tree_node* avl_find(AVL_Tree *self, const avl_key *key, bool greater, bool inclusive, bool exact);
+static inline tree_node* avl_lookup_node(struct AVL_Tree *self, int64_t key);
+static inline tree_node* avl_lookup_node_bytes(AVL_Tree *self, const void *key, size_t key_len);
+static bool avl_lookup_key(AVL_Tree *self, const avl_key *key, void *out, size_t capacity);
+static inline bool avl_lookup(AVL_Tree *self, int64_t key, void *out, size_t capacity);
+static inline bool avl_lookup_bytes(AVL_Tree *self, const void *key, size_t key_len, void *out, size_t capacity);
+static tree_node* avl_min(AVL_Tree *self);
+static tree_node* avl_max(AVL_Tree *self);
+static inline tree_node* avl_floor(AVL_Tree *self, int64_t key);
+static inline tree_node* avl_floor_bytes(AVL_Tree *self, const void *key, size_t key_len);
+static inline tree_node* avl_ceiling(AVL_Tree *self, int64_t key);
+static inline tree_node* avl_ceiling_bytes(AVL_Tree *self, const void *key, size_t key_len);
+static size_t avl_rank_node(const AVL_Tree *self, tree_node *root, const avl_key *key);
+static size_t avl_rank_key(AVL_Tree *self, const avl_key *key);
+static inline size_t avl_rank(AVL_Tree *self, int64_t key);
+static inline size_t avl_rank_bytes(AVL_Tree *self, const void *key, size_t key_len);
+static tree_node* avl_select_node(tree_node *node, size_t k);
+static tree_node* avl_select(AVL_Tree *self, size_t k);
+static size_t avl_count_between(const AVL_Tree *self, tree_node *root, const avl_key *lo, const avl_key *hi);
+static size_t avl_count_range_keys(AVL_Tree *self, const avl_key *lo, const avl_key *hi);
+static inline size_t avl_count_range(AVL_Tree *self, int64_t lo, int64_t hi);
+static inline size_t avl_count_range_bytes(AVL_Tree *self, const void *lo, size_t lo_len, const void *hi, size_t hi_len);
+static size_t avl_size(AVL_Tree *self);
+static void avl_range_walk(tree_node *node, int64_t lo, int64_t hi, void (*func)(int64_t key, void *data, va_list args), va_list *args);
+static void avl_range(AVL_Tree *self, int64_t lo, int64_t hi, void (*func)(int64_t key, void *data, va_list args), ...);
+static tree_node* avl_cursor_set(AVL_Tree *self, AVLCursor *cursor, tree_node *node);
+static tree_node* avl_cursor_descend(AVL_Tree *self, AVLCursor *cursor, const avl_key *key, bool greater, bool inclusive);
+static tree_node* avl_cursor_path_step(AVLCursor *cursor, bool forward);
+static tree_node* avl_cursor_first(AVL_Tree *self, AVLCursor *cursor);
+static tree_node* avl_cursor_last(AVL_Tree *self, AVLCursor *cursor);
+static tree_node* avl_cursor_seek_key(AVL_Tree *self, AVLCursor *cursor, const avl_key *key);
+static inline tree_node* avl_cursor_seek(AVL_Tree *self, AVLCursor *cursor, int64_t key);
+static inline tree_node* avl_cursor_seek_bytes(AVL_Tree *self, AVLCursor *cursor, const void *key, size_t key_len);
+static tree_node* avl_cursor_step(AVL_Tree *self, AVLCursor *cursor, bool forward);
+static inline tree_node* avl_cursor_next(AVL_Tree *self, AVLCursor *cursor);
+static inline tree_node* avl_cursor_prev(AVL_Tree *self, AVLCursor *cursor);
+static void avl_cursor_close(AVL_Tree *self, AVLCursor *cursor);
+static bool avl_set_comparator(AVL_Tree *self, avl_comparator compare);
+static void avl_set_destructor(AVL_Tree *self, void (*destructor)(void *data));
+static bool avl_use_arena(AVL_Tree *self);
+static bool avl_use_persistent(AVL_Tree *self);
+static AVLSnapshot* avl_snapshot(AVL_Tree *self);
+static tree_node* avl_snapshot_find(AVLSnapshot *self, const avl_key *key, bool greater, bool inclusive, bool exact);
+static inline tree_node* avl_snapshot_lookup(AVLSnapshot *self, int64_t key);
+static inline tree_node* avl_snapshot_lookup_bytes(AVLSnapshot *self, const void *key, size_t key_len);
+static inline tree_node* avl_snapshot_min(AVLSnapshot *self);
+static inline tree_node* avl_snapshot_max(AVLSnapshot *self);
+static inline tree_node* avl_snapshot_floor(AVLSnapshot *self, int64_t key);
+static inline tree_node* avl_snapshot_floor_bytes(AVLSnapshot *self, const void *key, size_t key_len);
+static inline tree_node* avl_snapshot_ceiling(AVLSnapshot *self, int64_t key);
+static inline tree_node* avl_snapshot_ceiling_bytes(AVLSnapshot *self, const void *key, size_t key_len);
+static size_t avl_snapshot_rank_key(AVLSnapshot *self, const avl_key *key);
+static inline size_t avl_snapshot_rank(AVLSnapshot *self, int64_t key);
+static inline size_t avl_snapshot_rank_bytes(AVLSnapshot *self, const void *key, size_t key_len);
+static inline tree_node* avl_snapshot_select(AVLSnapshot *self, size_t k);
+static inline size_t avl_snapshot_count_range(AVLSnapshot *self, int64_t lo, int64_t hi);
+static inline size_t avl_snapshot_count_range_bytes(AVLSnapshot *self, const void *lo, size_t lo_len, const void *hi, size_t hi_len);
+static inline size_t avl_snapshot_size(AVLSnapshot *self);
+static void avl_snapshot_range(AVLSnapshot *self, int64_t lo, int64_t hi, void (*func)(int64_t key, void *data, va_list args), ...);
+static void avl_snapshot_free(AVLSnapshot *self);
+static inline void avl_pin(AVL_Tree *self);
+static inline void avl_unpin(AVL_Tree *self);
+static void avl_free_subtree(AVL_Tree *self, tree_node *node);
+static void avl_retire_subtree(AVL_Tree *self, tree_node *node);
+static void avl_release_node_data(void *ctx, void *node);
+static void avl_clear(AVL_Tree *self);
 static void avl_free(AVL_Tree *self);
 
 
@@ -56,27 +317,89 @@ AVL_Tree* New_AVL_Tree() {
     self->self = self;
 
     self->root = NULL;
-
-    pthread_mutexattr_init(&self->mutex_attr);
-    pthread_mutexattr_settype(&self->mutex_attr, PTHREAD_MUTEX_RECURSIVE);
-
-    pthread_mutex_init(&self->mutex, &self->mutex_attr);
-
-    pthread_mutexattr_destroy(&self->mutex_attr);
+    self->version = 0;
+    self->byte_keys = false;
+    self->compare = NULL;
+    self->arena = false;
+    self->adopted_count = 0;
+    self->bulk = NULL;
+    self->bulk_bytes = 0;
+    self->persistent = false;
+    self->snapshots = 0;
+    self->epoch = 1;
+    self->generation = 0;
+    pthread_mutex_init(&self->snapshots_mutex, NULL);
+    self->oldest = NULL;
+    self->newest = NULL;
+
+    node_pool_init(&self->pool, sizeof(tree_node));
+    self->destructor = free;
+
+    pthread_rwlock_init(&self->lock, NULL);
 
     self->insert = avl_insert;
+    self->insert_bytes = avl_insert_bytes;
+    self->adopt = avl_adopt;
+    self->adopt_bytes = avl_adopt_bytes;
+    self->load_sorted = avl_load_sorted;
     self->delete = avl_delete;
+    self->delete_bytes = avl_delete_bytes;
+    self->steal = avl_steal;
+    self->steal_bytes = avl_steal_bytes;
     self->lookup = avl_lookup;
+    self->lookup_bytes = avl_lookup_bytes;
+    self->lookup_node = avl_lookup_node;
+    self->lookup_node_bytes = avl_lookup_node_bytes;
+    self->min = avl_min;
+    self->max = avl_max;
+    self->floor = avl_floor;
+    self->floor_bytes = avl_floor_bytes;
+    self->ceiling = avl_ceiling;
+    self->ceiling_bytes = avl_ceiling_bytes;
+    self->rank = avl_rank;
+    self->rank_bytes = avl_rank_bytes;
+    self->select = avl_select;
+    self->count_range = avl_count_range;
+    self->count_range_bytes = avl_count_range_bytes;
+    self->size = avl_size;
+    self->range = avl_range;
+    self->cursor_first = avl_cursor_first;
+    self->cursor_last = avl_cursor_last;
+    self->cursor_seek = avl_cursor_seek;
+    self->cursor_seek_bytes = avl_cursor_seek_bytes;
+    self->cursor_next = avl_cursor_next;
+    self->cursor_prev = avl_cursor_prev;
+    self->cursor_close = avl_cursor_close;
+    self->set_comparator = avl_set_comparator;
+    self->set_destructor = avl_set_destructor;
+    self->use_arena = avl_use_arena;
+    self->use_persistent = avl_use_persistent;
+    self->snapshot = avl_snapshot;
+    self->pin = avl_pin;
+    self->unpin = avl_unpin;
     self->free = avl_free;
 
     return self;
 }
 
 
-static size_t tree_node_height(tree_node *node) {
-    if (!node)
-        return 0;
-    return 1 + MAX(tree_node_height(node->left), tree_node_height(node->right));
+static inline int tree_node_height(const tree_node *node) {
+    return node ? node->height : 0;
+}
+
+
+static inline void tree_node_update_height(tree_node *node) {
+    node->height = 1 + MAX(tree_node_height(node->left), tree_node_height(node->right));
+}
+
+
+static inline size_t tree_node_count(const tree_node *node) {
+    return node ? node->count : 0;
+}
+
+
+static inline void tree_node_update_count(tree_node *node) {
+    node->count = 1 + tree_node_count(node->left) + tree_node_count(node->right);
 }
 
 
@@ -93,6 +416,11 @@ static tree_node* tree_node_left_rotate(tree_node *node) {
     b->parent = node->parent;
     node->parent = b;
 
+    tree_node_update_height(node);
+    tree_node_update_height(b);
+    tree_node_update_count(node);
+    tree_node_update_count(b);
+
     return b;
 }
 
@@ -110,215 +438,1588 @@ static tree_node* tree_node_right_rotate(tree_node *node) {
     b->parent = node->parent;
     node->parent = b;
 
+    tree_node_update_height(node);
+    tree_node_update_height(b);
+    tree_node_update_count(node);
+    tree_node_update_count(b);
+
     return b;
 }
 
 
-static int8_t tree_node_balance(tree_node *node) {
+static inline int tree_node_balance(const tree_node *node) {
     if (!node) 
         return 0;
     return tree_node_height(node->left) - tree_node_height(node->right);
 }
 
 
-static tree_node* init_avl_node(int key, void *data, size_t type_size) {
-    tree_node *node = (tree_node*) malloc(sizeof(tree_node));
-    
-    if (!node)
-        throw_memory_allocation_error();
+static inline avl_key avl_int_key(int64_t value) {
+    avl_key key = { value, NULL, 0, false };
+    return key;
+}
 
-    node->key = key;
-    node->data = copy_from_void_ptr(data, type_size);
-    node->type_size = type_size;
-    node->parent = node->left = node->right = NULL;
 
-    return node;
+static inline avl_key avl_bytes_key(const void *bytes, size_t len) {
+    avl_key key = { 0, bytes, len, true };
+    return key;
 }
 
 
-static tree_node* avl_insert_node(tree_node *node, int key, void *data, size_t type_size) {
-    if (!node)
-        return init_avl_node(key, data, type_size);
-
-    if (key < node->key) {
-        node->left = avl_insert_node(node->left, key, data, type_size);
-        if (node->left)
-            node->left->parent = node;
-    } else if (key > node->key) {
-        node->right = avl_insert_node(node->right, key, data, type_size);
-        if (node->right)
-            node->right->parent = node;
-    } else {
-        node->data = copy_from_void_ptr(data, type_size);
-        return node;
+static inline int avl_compare_bytes(const void *a, size_t a_len, const void *b, size_t b_len) {
+    size_t len = MIN(a_len, b_len);
+    int res = len > 0 ? memcmp(a, b, len) : 0;
+
+    if (res != 0)
+        return res;
+
+    return (a_len > b_len) - (a_len < b_len);
+}
+
+
+static inline int avl_compare(const AVL_Tree *self, const avl_key *key, const tree_node *node) {
+    if (!self->byte_keys)
+        return (key->value > node->key) - (key->value < node->key);
+
+    if (!self->compare)
+        return avl_compare_bytes(key->bytes, key->len, node->key_bytes, node->key_len);
+
+    return self->compare(key->bytes, key->len, node->key_bytes, node->key_len);
+}
+
+
+static inline void avl_check_key_type(const AVL_Tree *self, const avl_key *key) {
+    if (self->byte_keys != key->is_bytes) {
+        fprintf(stderr, "AVL_Tree key type mismatch\n");
+        exit(EXIT_FAILURE);
     }
+}
 
-    int balance = tree_node_balance(node);
 
-    if (balance > 1 && key < node->left->key)
-        return tree_node_right_rotate(node);
+static inline void avl_hold(AVL_Tree *self) {
+    if (avl_held_len < AVL_HELD_MAX)
+        avl_held[avl_held_len] = self;
+
+    avl_held_len++;
+}
 
-    if (balance < -1 && key > node->right->key)
-        return tree_node_left_rotate(node);
 
-    if (balance > 1 && key > node->left->key) {
-        node->left = tree_node_left_rotate(node->left);
-        if (node->left) 
-            node->left->parent = node;
-        return tree_node_right_rotate(node);
+static inline void avl_release(AVL_Tree *self) {
+    size_t len = MIN(avl_held_len, AVL_HELD_MAX);
+
+    for (size_t i=len; i>0; --i) {
+        if (avl_held[i - 1] == self) {
+            memmove(&avl_held[i - 1], &avl_held[i], (len - i) * sizeof(AVL_Tree*));
+            avl_held[len - 1] = NULL;
+            break;
+        }
     }
 
-    if (balance < -1 && key < node->right->key) {
-        node->right = tree_node_right_rotate(node->right);
-        if (node->right) 
-            node->right->parent = node;
-        return tree_node_left_rotate(node);
+    avl_held_len--;
+}
+
+
+static inline void avl_write_lock(AVL_Tree *self) {
+    for (size_t i=0; i<MIN(avl_held_len, AVL_HELD_MAX); ++i) {
+        if (avl_held[i] == self) {
+            fprintf(stderr, "AVL_Tree modified from inside pin or range on the same thread\n");
+            exit(EXIT_FAILURE);
+        }
     }
 
+    WRITE_LOCK(self->lock);
+}
+
+
+static tree_node* init_avl_node(AVL_Tree *self, const avl_key *key, void *data, size_t type_size, bool adopted, bool key_shared) {
+    tree_node *node = (tree_node*) node_pool_alloc(&self->pool);
+
+    node->key = key->value;
+    node->key_len = key->len;
+    node->key_shared = key_shared;
+    node->key_bytes = key_shared ? data : avl_copy_data(self, key->bytes, key->len);
+    node->height = 1;
+    node->count = 1;
+    node->data = data;
+    node->type_size = type_size;
+    node->adopted = adopted;
+    node->generation = self->generation;
+    node->parent = node->left = node->right = NULL;
+
     return node;
 }
 
 
-static void avl_insert(AVL_Tree *self, int key, void *data, size_t type_size) {
-    LOCK(self->mutex);
+static inline void* avl_copy_data(AVL_Tree *self, const void *data, size_t type_size) {
+    if (!self->arena || !data || type_size == 0)
+        return copy_from_void_ptr(data, type_size);
+
+    return memcpy(node_pool_alloc_bytes(&self->pool, type_size), data, type_size);
+}
 
-    self->root = avl_insert_node(self->root, key, data, type_size);
-    if (self->root)
-        self->root->parent = NULL;
 
-    UNLOCK(self->mutex);
+static void avl_reclaim_node(void *ctx, void *node) {
+    node_pool_release(&((AVL_Tree*) ctx)->pool, node);
 }
 
 
-static tree_node* get_min_node(tree_node* node) {
-    while (node && node->left)
-        node = node->left;
-    return node;
+static void avl_reclaim_adopted(void *ctx, void *data) {
+    ((AVL_Tree*) ctx)->destructor(data);
 }
 
 
-static tree_node* avl_delete_node(tree_node* node, int key) {
-    if (!node)
-        return NULL;
+static inline void avl_retire(AVL_Tree *self, void (*reclaim)(void *ctx, void *ptr), void *ptr) {
+    if (!self->persistent || !self->oldest) {
+        reclaim(self, ptr);
+        return;
+    }
 
-    if (key < node->key) {
-        node->left = avl_delete_node(node->left, key);
-        if (node->left)
-            node->left->parent = node;
-    } else if (key > node->key) {
-        node->right = avl_delete_node(node->right, key);
-        if (node->right)
-            node->right->parent = node;
-    } else {
-        if (!node->left || !node->right) {
-            tree_node *temp = node->left ? node->left : node->right;
-
-            if (!temp) {
-                free(node->data);
-                free(node);
-                return NULL;
-            } else {
-                temp->parent = node->parent;
-                free(node->data);
-                free(node);
-                return temp;
-            }
-        } else {
-            tree_node *successor = get_min_node(node->right);
-            node->key = successor->key;
-            node->data = copy_from_void_ptr(successor->data, successor->type_size);
+    epoch_bag_push(&self->retired, self->epoch, reclaim, self, ptr);
+
+    if (self->retired.len % EPOCH_COLLECT_THRESHOLD == 0)
+        epoch_bag_reclaim(&self->retired, self->oldest->epoch);
+}
+
+
+static inline bool avl_in_bulk(const AVL_Tree *self, const void *data) {
+    return self->bulk && (const char*) data >= self->bulk && (const char*) data < self->bulk + self->bulk_bytes;
+}
 
-            node->right = avl_delete_node(node->right, successor->key);
-            if (node->right)
-                node->right->parent = node;
+
+static inline void avl_release_data(AVL_Tree *self, void *data, bool adopted) {
+    if (!data)
+        return;
+
+    if (adopted) {
+        self->adopted_count--;
+        avl_retire(self, avl_reclaim_adopted, data);
+    } else if (!self->arena && !avl_in_bulk(self, data)) {
+        avl_retire(self, epoch_free, data);
+    }
+}
+
+
+static inline void avl_release_key(AVL_Tree *self, tree_node *node) {
+    if (!node->key_shared)
+        avl_release_data(self, node->key_bytes, false);
+}
+
+
+static inline void avl_replace_child(AVL_Tree *self, tree_node *parent, tree_node *old_child, tree_node *new_child) {
+    if (!parent)
+        self->root = new_child;
+    else if (parent->left == old_child)
+        parent->left = new_child;
+    else
+        parent->right = new_child;
+}
+
+
+static void avl_update_counts(tree_node *node) {
+    for (; node; node=node->parent)
+        tree_node_update_count(node);
+}
+
+
+static void avl_rebalance(AVL_Tree *self, tree_node *node) {
+    while (node) {
+        tree_node *parent = node->parent;
+        int old_height = node->height;
+
+        tree_node_update_height(node);
+        tree_node_update_count(node);
+
+        int balance = tree_node_balance(node);
+        tree_node *root = node;
+
+        if (balance > 1) {
+            if (tree_node_balance(node->left) < 0)
+                node->left = tree_node_left_rotate(node->left);
+            root = tree_node_right_rotate(node);
+        } else if (balance < -1) {
+            if (tree_node_balance(node->right) > 0)
+                node->right = tree_node_right_rotate(node->right);
+            root = tree_node_left_rotate(node);
         }
+
+        if (root != node) {
+            avl_replace_child(self, parent, node, root);
+        } else if (node->height == old_height) {
+            avl_update_counts(parent);
+            return;
+        }
+
+        node = parent;
+    }
+}
+
+
+static void avl_replace_data(AVL_Tree *self, tree_node *node, const avl_key *key, void *data, size_t type_size, bool adopted, bool key_shared) {
+    if (key_shared) {
+        avl_release_key(self, node);
+        node->key_bytes = data;
+        node->key_len = key->len;
+    } else if (node->key_shared) {
+        node->key_bytes = avl_copy_data(self, node->key_bytes, node->key_len);
+    }
+
+    node->key_shared = key_shared;
+
+    avl_release_data(self, node->data, node->adopted);
+
+    if (adopted)
+        self->adopted_count++;
+
+    node->data = data;
+    node->type_size = type_size;
+    node->adopted = adopted;
+}
+
+
+static void avl_path_reset_generation(tree_node *node) {
+    for (; node; node = node->right) {
+        node->generation = 0;
+        avl_path_reset_generation(node->left);
+    }
+}
+
+
+static inline void avl_path_begin(AVL_Tree *self) {
+    if (++self->generation == 0) {
+        avl_path_reset_generation(self->root);
+        self->generation = 1;
     }
+}
+
+
+static tree_node* avl_path_copy(AVL_Tree *self, tree_node *node) {
+    if (node->generation == self->generation)
+        return node;
+
+    tree_node *copy = (tree_node*) node_pool_alloc(&self->pool);
+
+    *copy = *node;
+    copy->parent = NULL;
+    copy->generation = self->generation;
+
+    avl_retire(self, avl_reclaim_node, node);
+
+    return copy;
+}
+
+
+static tree_node* avl_path_left_rotate(AVL_Tree *self, tree_node *node) {
+    tree_node *b = avl_path_copy(self, node->right);
+
+    node->right = b->left;
+    b->left = node;
+
+    tree_node_update_height(node);
+    tree_node_update_height(b);
+    tree_node_update_count(node);
+    tree_node_update_count(b);
+
+    return b;
+}
+
+
+static tree_node* avl_path_right_rotate(AVL_Tree *self, tree_node *node) {
+    tree_node *b = avl_path_copy(self, node->left);
+
+    node->left = b->right;
+    b->right = node;
+
+    tree_node_update_height(node);
+    tree_node_update_height(b);
+    tree_node_update_count(node);
+    tree_node_update_count(b);
+
+    return b;
+}
+
+
+static tree_node* avl_path_balance(AVL_Tree *self, tree_node *node) {
+    tree_node_update_height(node);
+    tree_node_update_count(node);
 
     int balance = tree_node_balance(node);
 
     if (balance > 1) {
-        if (tree_node_balance(node->left) >= 0)
-            return tree_node_right_rotate(node);
-        else {
-            node->left = tree_node_left_rotate(node->left);
-            if (node->left) 
-                node->left->parent = node;
-            return tree_node_right_rotate(node);
-        }
+        if (tree_node_balance(node->left) < 0)
+            node->left = avl_path_left_rotate(self, avl_path_copy(self, node->left));
+        return avl_path_right_rotate(self, node);
     }
 
     if (balance < -1) {
-        if (tree_node_balance(node->right) <= 0)
-            return tree_node_left_rotate(node);
-        else {
-            node->right = tree_node_right_rotate(node->right);
-            if (node->right)
-                node->right->parent = node;
-            return tree_node_left_rotate(node);
-        }
+        if (tree_node_balance(node->right) > 0)
+            node->right = avl_path_right_rotate(self, avl_path_copy(self, node->right));
+        return avl_path_left_rotate(self, node);
     }
 
     return node;
 }
 
 
-static void avl_delete(AVL_Tree *self, int key) {
-    LOCK(self->mutex);
+static tree_node* avl_path_insert(AVL_Tree *self, tree_node *node, const avl_key *key, void *data, size_t type_size, bool adopted, bool key_shared) {
+    if (!node) {
+        if (adopted)
+            self->adopted_count++;
 
-    if (!self || !self->root) 
-        goto un;
+        self->version++;
 
-    self->root = avl_delete_node(self->root, key);
+        return init_avl_node(self, key, data, type_size, adopted, key_shared);
+    }
 
-    if (self->root)
-        self->root->parent = NULL;
+    int cmp = avl_compare(self, key, node);
 
-    un:
-        UNLOCK(self->mutex);
-}
+    if (cmp == 0) {
+        tree_node *copy = avl_path_copy(self, node);
+        avl_replace_data(self, copy, key, data, type_size, adopted, key_shared);
+        self->version++;
+        return copy;
+    }
 
+    tree_node *child = avl_path_insert(self, cmp < 0 ? node->left : node->right, key, data, type_size, adopted, key_shared);
+    tree_node *copy = avl_path_copy(self, node);
 
-static tree_node* avl_search_node(tree_node *node, int key) {
-    if (!node || node->key == key)
-        return node;
-    if (key > node->key)
-        return avl_search_node(node->right, key);
+    if (cmp < 0)
+        copy->left = child;
     else
-        return avl_search_node(node->left, key);
+        copy->right = child;
+
+    return avl_path_balance(self, copy);
 }
 
 
-static inline tree_node* avl_lookup(AVL_Tree *self, int key) {
-    LOCK(self->mutex);
+static void avl_insert_data(AVL_Tree *self, const avl_key *key, void *data, size_t type_size, bool adopted, bool key_shared) {
+    tree_node *parent = NULL;
+    tree_node **link = &self->root;
 
-    tree_node *res = avl_search_node(self->root, key);
-    
-    UNLOCK(self->mutex);
-    
-    return res;
+    avl_check_key_type(self, key);
+
+    if (self->persistent) {
+        avl_path_begin(self);
+        self->root = avl_path_insert(self, self->root, key, data, type_size, adopted, key_shared);
+        return;
+    }
+
+    while (*link) {
+        parent = *link;
+
+        int cmp = avl_compare(self, key, parent);
+
+        if (cmp < 0) {
+            link = &parent->left;
+        } else if (cmp > 0) {
+            link = &parent->right;
+        } else {
+            avl_replace_data(self, parent, key, data, type_size, adopted, key_shared);
+            return;
+        }
+    }
+
+    tree_node *node = init_avl_node(self, key, data, type_size, adopted, key_shared);
+    node->parent = parent;
+    *link = node;
+
+    if (adopted)
+        self->adopted_count++;
+
+    self->version++;
+
+    avl_rebalance(self, parent);
 }
 
 
-static void avl_free_subtree(tree_node *node) {
-    if (!node)
-        return;
+static void avl_insert(AVL_Tree *self, int64_t key, void *data, size_t type_size) {
+    avl_write_lock(self);
 
-    avl_free_subtree(node->left);
-    avl_free_subtree(node->right);
+    avl_key probe = avl_int_key(key);
+    avl_insert_data(self, &probe, avl_copy_data(self, data, type_size), type_size, false, false);
 
-    free(node->data);
-    free(node);
+    RW_UNLOCK(self->lock);
 }
 
 
-static void avl_free(AVL_Tree *self) {
-    LOCK(self->mutex);
+static void avl_insert_bytes(AVL_Tree *self, const void *key, size_t key_len, void *data, size_t type_size) {
+    avl_write_lock(self);
 
-    avl_free_subtree(self->root);
-    
-    UNLOCK(self->mutex);
-    pthread_mutex_destroy(&self->mutex);
-    
-    free(self);
+    void *copy = avl_copy_data(self, data, type_size);
+    avl_key probe = avl_bytes_key(key, key_len);
+
+    avl_insert_data(self, &probe, copy, type_size, false, copy && key == data && key_len == type_size);
+
+    RW_UNLOCK(self->lock);
+}
+
+
+static void avl_adopt(AVL_Tree *self, int64_t key, void *data, size_t type_size) {
+    avl_write_lock(self);
+
+    avl_key probe = avl_int_key(key);
+    avl_insert_data(self, &probe, data, type_size, true, false);
+
+    RW_UNLOCK(self->lock);
+}
+
+
+static void avl_adopt_bytes(AVL_Tree *self, const void *key, size_t key_len, void *data, size_t type_size) {
+    avl_write_lock(self);
+
+    avl_key probe = avl_bytes_key(key, key_len);
+    avl_insert_data(self, &probe, data, type_size, true, data && key == data && key_len == type_size);
+
+    RW_UNLOCK(self->lock);
+}
+
+
+static tree_node* avl_build_range(const avl_build_source *source, size_t lo, size_t hi, tree_node *parent, int spawn_depth) {
+    if (lo >= hi)
+        return NULL;
+
+    size_t mid = lo + (hi - lo) / 2;
+    tree_node *node = &source->nodes[mid];
+
+    node->key = source->keys[mid];
+    node->key_bytes = NULL;
+    node->key_len = 0;
+    node->key_shared = false;
+    node->data = NULL;
+
+    if (source->data && source->data[mid] && source->type_size > 0)
+        node->data = memcpy(source->values + mid * source->type_size, source->data[mid], source->type_size);
+
+    node->type_size = node->data ? source->type_size : 0;
+    node->adopted = false;
+    node->generation = 0;
+    node->parent = parent;
+
+    pthread_t thread;
+    avl_build_job job = { source, lo, mid, node, spawn_depth - 1, NULL };
+    bool spawned = spawn_depth > 0 && hi - lo >= AVL_TREE_PARALLEL_THRESHOLD && pthread_create(&thread, NULL, avl_build_worker, &job) == 0;
+
+    if (!spawned)
+        job.root = avl_build_range(source, lo, mid, node, spawn_depth - 1);
+
+    node->right = avl_build_range(source, mid + 1, hi, node, spawn_depth - 1);
+
+    if (spawned)
+        pthread_join(thread, NULL);
+
+    node->left = job.root;
+    tree_node_update_height(node);
+    node->count = hi - lo;
+
+    return node;
+}
+
+
+static void* avl_build_worker(void *arg) {
+    avl_build_job *job = (avl_build_job*) arg;
+
+    job->root = avl_build_range(job->source, job->lo, job->hi, job->parent, job->spawn_depth);
+
+    return NULL;
+}
+
+
+static bool avl_load_sorted(AVL_Tree *self, const int64_t *keys, void **data, size_t type_size, size_t n) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int spawn_depth = 0;
+
+    while (spawn_depth < 16 && (1L << spawn_depth) < cpus)
+        spawn_depth++;
+
+    avl_write_lock(self);
+
+    bool sorted = !self->byte_keys;
+
+    for (size_t i=1; sorted && i<n; ++i)
+        sorted = keys[i - 1] < keys[i];
+
+    if (!sorted) {
+        RW_UNLOCK(self->lock);
+        return false;
+    }
+
+    if (self->persistent) {
+        avl_retire_subtree(self, self->root);
+        self->root = NULL;
+
+        if (self->bulk)
+            avl_retire(self, epoch_free, self->bulk);
+
+        self->bulk = NULL;
+        self->bulk_bytes = 0;
+    } else {
+        avl_clear(self);
+    }
+
+    avl_build_source source = { (tree_node*) node_pool_alloc_array(&self->pool, n), NULL, keys, data, type_size };
+
+    if (data && n > 0 && type_size > 0) {
+        if (self->arena) {
+            source.values = (char*) node_pool_alloc_bytes(&self->pool, n * type_size);
+        } else {
+            source.values = (char*) malloc(n * type_size);
+
+            if (!source.values)
+                throw_memory_allocation_error();
+
+            self->bulk = source.values;
+            self->bulk_bytes = n * type_size;
+        }
+    }
+
+    self->root = avl_build_range(&source, 0, n, NULL, spawn_depth);
+    self->version++;
+
+    RW_UNLOCK(self->lock);
+
+    return true;
 }
 
+
+static tree_node* get_min_node(tree_node* node) {
+    while (node && node->left)
+        node = node->left;
+    return node;
+}
+
+
+static tree_node* get_max_node(tree_node* node) {
+    while (node && node->right)
+        node = node->right;
+    return node;
+}
+
+
+static tree_node* avl_successor(tree_node *node) {
+    if (node->right)
+        return get_min_node(node->right);
+
+    while (node->parent && node->parent->right == node)
+        node = node->parent;
+
+    return node->parent;
+}
+
+
+static tree_node* avl_predecessor(tree_node *node) {
+    if (node->left)
+        return get_max_node(node->left);
+
+    while (node->parent && node->parent->left == node)
+        node = node->parent;
+
+    return node->parent;
+}
+
+
+static tree_node* avl_search_node(const AVL_Tree *self, tree_node *root, const avl_key *key) {
+    tree_node *node = root;
+
+    if (!self->byte_keys) {
+        int64_t value = key->value;
+
+        while (node && node->key != value)
+            node = value > node->key ? node->right : node->left;
+
+        return node;
+    }
+
+    while (node) {
+        int cmp = avl_compare(self, key, node);
+
+        if (cmp == 0)
+            break;
+
+        node = cmp > 0 ? node->right : node->left;
+    }
+
+    return node;
+}
+
+
+static tree_node* avl_bound_node(const AVL_Tree *self, tree_node *root, const avl_key *key, bool greater, bool inclusive) {
+    tree_node *node = root;
+    tree_node *res = NULL;
+
+    while (node) {
+        int cmp = avl_compare(self, key, node);
+
+        if (cmp == 0 && inclusive)
+            return node;
+
+        if (greater ? cmp < 0 : cmp > 0) {
+            res = node;
+            node = greater ? node->left : node->right;
+        } else {
+            node = greater ? node->right : node->left;
+        }
+    }
+
+    return res;
+}
+
+
+static tree_node* avl_path_remove_min(AVL_Tree *self, tree_node *node, tree_node **min) {
+    if (!node->left) {
+        *min = node;
+        return node->right;
+    }
+
+    tree_node *left = avl_path_remove_min(self, node->left, min);
+    tree_node *copy = avl_path_copy(self, node);
+
+    copy->left = left;
+
+    return avl_path_balance(self, copy);
+}
+
+
+static tree_node* avl_path_remove(AVL_Tree *self, tree_node *node, const avl_key *key, tree_node *removed, bool *found) {
+    if (!node)
+        return NULL;
+
+    int cmp = avl_compare(self, key, node);
+
+    if (cmp != 0) {
+        tree_node *child = avl_path_remove(self, cmp < 0 ? node->left : node->right, key, removed, found);
+
+        if (!*found)
+            return node;
+
+        tree_node *copy = avl_path_copy(self, node);
+
+        if (cmp < 0)
+            copy->left = child;
+        else
+            copy->right = child;
+
+        return avl_path_balance(self, copy);
+    }
+
+    *found = true;
+
+    removed->data = node->data;
+    removed->type_size = node->type_size;
+    removed->adopted = node->adopted;
+
+    avl_release_key(self, node);
+
+    tree_node *left = node->left;
+    tree_node *right = node->right;
+
+    avl_retire(self, avl_reclaim_node, node);
+
+    if (!left || !right)
+        return left ? left : right;
+
+    tree_node *min = NULL;
+    right = avl_path_remove_min(self, right, &min);
+
+    tree_node *copy = avl_path_copy(self, min);
+
+    copy->left = left;
+    copy->right = right;
+
+    return avl_path_balance(self, copy);
+}
+
+
+static bool avl_remove(AVL_Tree *self, const avl_key *key, tree_node *removed) {
+    avl_check_key_type(self, key);
+
+    if (self->persistent) {
+        bool found = false;
+
+        avl_path_begin(self);
+        self->root = avl_path_remove(self, self->root, key, removed, &found);
+
+        if (found)
+            self->version++;
+
+        return found;
+    }
+
+    tree_node *node = avl_search_node(self, self->root, key);
+
+    if (!node)
+        return false;
+
+    removed->data = node->data;
+    removed->type_size = node->type_size;
+    removed->adopted = node->adopted;
+
+    avl_release_key(self, node);
+
+    tree_node *parent = node->parent;
+    tree_node *start = parent;
+
+    if (node->left && node->right) {
+        tree_node *successor = get_min_node(node->right);
+
+        if (successor->parent != node) {
+            start = successor->parent;
+            start->left = successor->right;
+
+            if (successor->right)
+                successor->right->parent = start;
+
+            successor->right = node->right;
+            node->right->parent = successor;
+        } else {
+            start = successor;
+        }
+
+        successor->left = node->left;
+        node->left->parent = successor;
+        successor->parent = parent;
+        successor->height = node->height;
+
+        avl_replace_child(self, parent, node, successor);
+    } else {
+        tree_node *child = node->left ? node->left : node->right;
+
+        if (child)
+            child->parent = parent;
+
+        avl_replace_child(self, parent, node, child);
+    }
+
+    node_pool_release(&self->pool, node);
+
+    self->version++;
+
+    avl_rebalance(self, start);
+
+    return true;
+}
+
+
+static void avl_delete_key(AVL_Tree *self, const avl_key *key) {
+    tree_node removed = { .data = NULL };
+
+    if (avl_remove(self, key, &removed))
+        avl_release_data(self, removed.data, removed.adopted);
+}
+
+
+static void avl_delete(AVL_Tree *self, int64_t key) {
+    avl_write_lock(self);
+
+    avl_key probe = avl_int_key(key);
+    avl_delete_key(self, &probe);
+
+    RW_UNLOCK(self->lock);
+}
+
+
+static void avl_delete_bytes(AVL_Tree *self, const void *key, size_t key_len) {
+    avl_write_lock(self);
+
+    avl_key probe = avl_bytes_key(key, key_len);
+    avl_delete_key(self, &probe);
+
+    RW_UNLOCK(self->lock);
+}
+
+
+static void* avl_steal_key(AVL_Tree *self, const avl_key *key) {
+    tree_node removed = { .data = NULL };
+
+    if (avl_remove(self, key, &removed) && removed.data) {
+        void *stored = removed.data;
+
+        if (removed.adopted) {
+            self->adopted_count--;
+        } else if (self->arena || avl_in_bulk(self, stored)) {
+            removed.data = copy_from_void_ptr(stored, removed.type_size);
+        } else if (self->persistent && __atomic_load_n(&self->snapshots, __ATOMIC_ACQUIRE) > 0) {
+            removed.data = copy_from_void_ptr(stored, removed.type_size);
+            avl_release_data(self, stored, false);
+        }
+    }
+
+    return removed.data;
+}
+
+
+static void* avl_steal(AVL_Tree *self, int64_t key) {
+    avl_write_lock(self);
+
+    avl_key probe = avl_int_key(key);
+    void *res = avl_steal_key(self, &probe);
+
+    RW_UNLOCK(self->lock);
+
+    return res;
+}
+
+
+static void* avl_steal_bytes(AVL_Tree *self, const void *key, size_t key_len) {
+    avl_write_lock(self);
+
+    avl_key probe = avl_bytes_key(key, key_len);
+    void *res = avl_steal_key(self, &probe);
+
+    RW_UNLOCK(self->lock);
+
+    return res;
+}
+
+
+static tree_node* avl_find(AVL_Tree *self, const avl_key *key, bool greater, bool inclusive, bool exact) {
+    READ_LOCK(self->lock);
+
+    avl_check_key_type(self, key);
+
+    tree_node *res = exact ? avl_search_node(self, self->root, key) : avl_bound_node(self, self->root, key, greater, inclusive);
+
+    RW_UNLOCK(self->lock);
+
+    return res;
+}
+
+
+static inline tree_node* avl_lookup_node(AVL_Tree *self, int64_t key) {
+    avl_key probe = avl_int_key(key);
+    return avl_find(self, &probe, false, true, true);
+}
+
+
+static inline tree_node* avl_lookup_node_bytes(AVL_Tree *self, const void *key, size_t key_len) {
+    avl_key probe = avl_bytes_key(key, key_len);
+    return avl_find(self, &probe, false, true, true);
+}
+
+
+static bool avl_lookup_key(AVL_Tree *self, const avl_key *key, void *out, size_t capacity) {
+    READ_LOCK(self->lock);
+
+    avl_check_key_type(self, key);
+
+    tree_node *node = avl_search_node(self, self->root, key);
+
+    if (node && node->data && out)
+        memcpy(out, node->data, MIN(node->type_size, capacity));
+
+    RW_UNLOCK(self->lock);
+
+    return node != NULL;
+}
+
+
+static inline bool avl_lookup(AVL_Tree *self, int64_t key, void *out, size_t capacity) {
+    avl_key probe = avl_int_key(key);
+    return avl_lookup_key(self, &probe, out, capacity);
+}
+
+
+static inline bool avl_lookup_bytes(AVL_Tree *self, const void *key, size_t key_len, void *out, size_t capacity) {
+    avl_key probe = avl_bytes_key(key, key_len);
+    return avl_lookup_key(self, &probe, out, capacity);
+}
+
+
+static tree_node* avl_min(AVL_Tree *self) {
+    READ_LOCK(self->lock);
+
+    tree_node *res = get_min_node(self->root);
+
+    RW_UNLOCK(self->lock);
+
+    return res;
+}
+
+
+static tree_node* avl_max(AVL_Tree *self) {
+    READ_LOCK(self->lock);
+
+    tree_node *res = get_max_node(self->root);
+
+    RW_UNLOCK(self->lock);
+
+    return res;
+}
+
+
+static inline tree_node* avl_floor(AVL_Tree *self, int64_t key) {
+    avl_key probe = avl_int_key(key);
+    return avl_find(self, &probe, false, true, false);
+}
+
+
+static inline tree_node* avl_floor_bytes(AVL_Tree *self, const void *key, size_t key_len) {
+    avl_key probe = avl_bytes_key(key, key_len);
+    return avl_find(self, &probe, false, true, false);
+}
+
+
+static inline tree_node* avl_ceiling(AVL_Tree *self, int64_t key) {
+    avl_key probe = avl_int_key(key);
+    return avl_find(self, &probe, true, true, false);
+}
+
+
+static inline tree_node* avl_ceiling_bytes(AVL_Tree *self, const void *key, size_t key_len) {
+    avl_key probe = avl_bytes_key(key, key_len);
+    return avl_find(self, &probe, true, true, false);
+}
+
+
+static size_t avl_rank_node(const AVL_Tree *self, tree_node *root, const avl_key *key) {
+    size_t rank = 0;
+    tree_node *node = root;
+
+    while (node) {
+        if (avl_compare(self, key, node) <= 0) {
+            node = node->left;
+        } else {
+            rank += tree_node_count(node->left) + 1;
+            node = node->right;
+        }
+    }
+
+    return rank;
+}
+
+
+static size_t avl_rank_key(AVL_Tree *self, const avl_key *key) {
+    READ_LOCK(self->lock);
+
+    avl_check_key_type(self, key);
+
+    size_t rank = avl_rank_node(self, self->root, key);
+
+    RW_UNLOCK(self->lock);
+
+    return rank;
+}
+
+
+static inline size_t avl_rank(AVL_Tree *self, int64_t key) {
+    avl_key probe = avl_int_key(key);
+    return avl_rank_key(self, &probe);
+}
+
+
+static inline size_t avl_rank_bytes(AVL_Tree *self, const void *key, size_t key_len) {
+    avl_key probe = avl_bytes_key(key, key_len);
+    return avl_rank_key(self, &probe);
+}
+
+
+static tree_node* avl_select_node(tree_node *node, size_t k) {
+    while (node) {
+        size_t left = tree_node_count(node->left);
+
+        if (k < left) {
+            node = node->left;
+        } else if (k > left) {
+            k -= left + 1;
+            node = node->right;
+        } else {
+            break;
+        }
+    }
+
+    return node;
+}
+
+
+static tree_node* avl_select(AVL_Tree *self, size_t k) {
+    READ_LOCK(self->lock);
+
+    tree_node *node = avl_select_node(self->root, k);
+
+    RW_UNLOCK(self->lock);
+
+    return node;
+}
+
+
+static size_t avl_count_between(const AVL_Tree *self, tree_node *root, const avl_key *lo, const avl_key *hi) {
+    avl_check_key_type(self, lo);
+    avl_check_key_type(self, hi);
+
+    size_t lo_rank = avl_rank_node(self, root, lo);
+    size_t hi_rank = avl_rank_node(self, root, hi);
+
+    return hi_rank > lo_rank ? hi_rank - lo_rank : 0;
+}
+
+
+static size_t avl_count_range_keys(AVL_Tree *self, const avl_key *lo, const avl_key *hi) {
+    READ_LOCK(self->lock);
+
+    size_t count = avl_count_between(self, self->root, lo, hi);
+
+    RW_UNLOCK(self->lock);
+
+    return count;
+}
+
+
+static inline size_t avl_count_range(AVL_Tree *self, int64_t lo, int64_t hi) {
+    avl_key lo_probe = avl_int_key(lo);
+    avl_key hi_probe = avl_int_key(hi);
+    return avl_count_range_keys(self, &lo_probe, &hi_probe);
+}
+
+
+static inline size_t avl_count_range_bytes(AVL_Tree *self, const void *lo, size_t lo_len, const void *hi, size_t hi_len) {
+    avl_key lo_probe = avl_bytes_key(lo, lo_len);
+    avl_key hi_probe = avl_bytes_key(hi, hi_len);
+    return avl_count_range_keys(self, &lo_probe, &hi_probe);
+}
+
+
+static size_t avl_size(AVL_Tree *self) {
+    READ_LOCK(self->lock);
+
+    size_t size = tree_node_count(self->root);
+
+    RW_UNLOCK(self->lock);
+
+    return size;
+}
+
+
+static void avl_range_walk(tree_node *node, int64_t lo, int64_t hi, void (*func)(int64_t key, void *data, va_list args), va_list *args) {
+    while (node) {
+        if (node->key >= hi) {
+            node = node->left;
+            continue;
+        }
+
+        if (node->key >= lo) {
+            avl_range_walk(node->left, lo, hi, func, args);
+
+            va_list args_copy;
+            va_copy(args_copy, *args);
+            func(node->key, node->data, args_copy);
+            va_end(args_copy);
+        }
+
+        node = node->right;
+    }
+}
+
+
+static void avl_range(AVL_Tree *self, int64_t lo, int64_t hi, void (*func)(int64_t key, void *data, va_list args), ...) {
+    READ_LOCK(self->lock);
+
+    avl_key probe = avl_int_key(lo);
+    avl_check_key_type(self, &probe);
+
+    va_list args;
+    va_start(args, func);
+
+    avl_hold(self);
+    avl_range_walk(self->root, lo, hi, func, &args);
+    avl_release(self);
+
+    va_end(args);
+
+    RW_UNLOCK(self->lock);
+}
+
+
+static tree_node* avl_cursor_set(AVL_Tree *self, AVLCursor *cursor, tree_node *node) {
+    cursor->node = node;
+    cursor->version = self->version;
+
+    if (!node)
+        return NULL;
+
+    cursor->key = node->key;
+
+    if (self->byte_keys) {
+        if (cursor->key_capacity < node->key_len) {
+            char *key_bytes = (char*) realloc(cursor->key_bytes, node->key_len);
+
+            if (!key_bytes)
+                throw_memory_allocation_error();
+
+            cursor->key_bytes = key_bytes;
+            cursor->key_capacity = node->key_len;
+        }
+
+        if (node->key_len > 0)
+            memcpy(cursor->key_bytes, node->key_bytes, node->key_len);
+
+        cursor->key_len = node->key_len;
+    }
+
+    return node;
+}
+
+
+static tree_node* avl_cursor_descend(AVL_Tree *self, AVLCursor *cursor, const avl_key *key, bool greater, bool inclusive) {
+    tree_node *res = NULL;
+    size_t depth = 0;
+
+    cursor->depth = 0;
+
+    for (tree_node *node = self->root; node;) {
+        int cmp = key ? avl_compare(self, key, node) : (greater ? -1 : 1);
+
+        cursor->path[depth++] = node;
+
+        if ((greater ? cmp < 0 : cmp > 0) || (inclusive && cmp == 0)) {
+            res = node;
+            cursor->depth = depth;
+
+            if (cmp == 0)
+                break;
+        }
+
+        node = cmp < 0 || (cmp == 0 && !greater) ? node->left : node->right;
+    }
+
+    return res;
+}
+
+
+static tree_node* avl_cursor_path_step(AVLCursor *cursor, bool forward) {
+    tree_node *node = cursor->path[cursor->depth - 1];
+    tree_node *child = forward ? node->right : node->left;
+
+    if (child) {
+        for (; child; child = forward ? child->left : child->right)
+            cursor->path[cursor->depth++] = child;
+
+        return cursor->path[cursor->depth - 1];
+    }
+
+    while (--cursor->depth > 0) {
+        tree_node *parent = cursor->path[cursor->depth - 1];
+
+        if ((forward ? parent->left : parent->right) == node)
+            return parent;
+
+        node = parent;
+    }
+
+    return NULL;
+}
+
+
+static tree_node* avl_cursor_first(AVL_Tree *self, AVLCursor *cursor) {
+    READ_LOCK(self->lock);
+
+    tree_node *res = avl_cursor_set(self, cursor, self->persistent ? avl_cursor_descend(self, cursor, NULL, true, true) : get_min_node(self->root));
+
+    RW_UNLOCK(self->lock);
+
+    return res;
+}
+
+
+static tree_node* avl_cursor_last(AVL_Tree *self, AVLCursor *cursor) {
+    READ_LOCK(self->lock);
+
+    tree_node *res = avl_cursor_set(self, cursor, self->persistent ? avl_cursor_descend(self, cursor, NULL, false, true) : get_max_node(self->root));
+
+    RW_UNLOCK(self->lock);
+
+    return res;
+}
+
+
+static tree_node* avl_cursor_seek_key(AVL_Tree *self, AVLCursor *cursor, const avl_key *key) {
+    READ_LOCK(self->lock);
+
+    avl_check_key_type(self, key);
+
+    tree_node *res = avl_cursor_set(self, cursor, self->persistent ? avl_cursor_descend(self, cursor, key, true, true) : avl_bound_node(self, self->root, key, true, true));
+
+    RW_UNLOCK(self->lock);
+
+    return res;
+}
+
+
+static inline tree_node* avl_cursor_seek(AVL_Tree *self, AVLCursor *cursor, int64_t key) {
+    avl_key probe = avl_int_key(key);
+    return avl_cursor_seek_key(self, cursor, &probe);
+}
+
+
+static inline tree_node* avl_cursor_seek_bytes(AVL_Tree *self, AVLCursor *cursor, const void *key, size_t key_len) {
+    avl_key probe = avl_bytes_key(key, key_len);
+    return avl_cursor_seek_key(self, cursor, &probe);
+}
+
+
+static tree_node* avl_cursor_step(AVL_Tree *self, AVLCursor *cursor, bool forward) {
+    READ_LOCK(self->lock);
+
+    tree_node *res = NULL;
+
+    if (!cursor->node)
+        goto un;
+
+    avl_key probe = { cursor->key, cursor->key_bytes, cursor->key_len, self->byte_keys };
+
+    if (cursor->version != self->version)
+        res = self->persistent ? avl_cursor_descend(self, cursor, &probe, forward, false) : avl_bound_node(self, self->root, &probe, forward, false);
+    else if (self->persistent)
+        res = avl_cursor_path_step(cursor, forward);
+    else
+        res = forward ? avl_successor(cursor->node) : avl_predecessor(cursor->node);
+
+    avl_cursor_set(self, cursor, res);
+
+    un:
+        RW_UNLOCK(self->lock);
+
+    return res;
+}
+
+
+static inline tree_node* avl_cursor_next(AVL_Tree *self, AVLCursor *cursor) {
+    return avl_cursor_step(self, cursor, true);
+}
+
+
+static inline tree_node* avl_cursor_prev(AVL_Tree *self, AVLCursor *cursor) {
+    return avl_cursor_step(self, cursor, false);
+}
+
+
+static void avl_cursor_close(AVL_Tree *self, AVLCursor *cursor) {
+    (void) self;
+
+    free(cursor->key_bytes);
+
+    cursor->node = NULL;
+    cursor->key_bytes = NULL;
+    cursor->key_len = 0;
+    cursor->key_capacity = 0;
+}
+
+
+static bool avl_set_comparator(AVL_Tree *self, avl_comparator compare) {
+    avl_write_lock(self);
+
+    bool res = self->root == NULL && __atomic_load_n(&self->snapshots, __ATOMIC_ACQUIRE) == 0;
+
+    if (res) {
+        self->byte_keys = true;
+        self->compare = compare;
+    }
+
+    RW_UNLOCK(self->lock);
+
+    return res;
+}
+
+
+static void avl_set_destructor(AVL_Tree *self, void (*destructor)(void *data)) {
+    avl_write_lock(self);
+
+    self->destructor = destructor;
+
+    RW_UNLOCK(self->lock);
+}
+
+
+static bool avl_use_arena(AVL_Tree *self) {
+    avl_write_lock(self);
+
+    bool res = self->root == NULL;
+
+    if (res)
+        self->arena = true;
+
+    RW_UNLOCK(self->lock);
+
+    return res;
+}
+
+
+static bool avl_use_persistent(AVL_Tree *self) {
+    avl_write_lock(self);
+
+    bool res = self->root == NULL && !self->persistent;
+
+    if (res) {
+        self->persistent = true;
+        epoch_bag_init(&self->retired);
+    }
+
+    RW_UNLOCK(self->lock);
+
+    return res;
+}
+
+
+static AVLSnapshot* avl_snapshot(AVL_Tree *self) {
+    if (!self->persistent)
+        return NULL;
+
+    AVLSnapshot *snapshot = (AVLSnapshot*) malloc(sizeof(AVLSnapshot));
+
+    if (!snapshot)
+        throw_memory_allocation_error();
+
+    snapshot->self = snapshot;
+    snapshot->tree = self;
+
+    READ_LOCK(self->lock);
+    LOCK(self->snapshots_mutex);
+
+    __atomic_add_fetch(&self->snapshots, 1, __ATOMIC_ACQ_REL);
+
+    snapshot->root = self->root;
+    snapshot->epoch = __atomic_add_fetch(&self->epoch, 1, __ATOMIC_ACQ_REL);
+    snapshot->prev = self->newest;
+    snapshot->next = NULL;
+
+    if (self->newest)
+        self->newest->next = snapshot;
+    else
+        self->oldest = snapshot;
+
+    self->newest = snapshot;
+
+    UNLOCK(self->snapshots_mutex);
+    RW_UNLOCK(self->lock);
+
+    snapshot->lookup = avl_snapshot_lookup;
+    snapshot->lookup_bytes = avl_snapshot_lookup_bytes;
+    snapshot->min = avl_snapshot_min;
+    snapshot->max = avl_snapshot_max;
+    snapshot->floor = avl_snapshot_floor;
+    snapshot->floor_bytes = avl_snapshot_floor_bytes;
+    snapshot->ceiling = avl_snapshot_ceiling;
+    snapshot->ceiling_bytes = avl_snapshot_ceiling_bytes;
+    snapshot->rank = avl_snapshot_rank;
+    snapshot->rank_bytes = avl_snapshot_rank_bytes;
+    snapshot->select = avl_snapshot_select;
+    snapshot->count_range = avl_snapshot_count_range;
+    snapshot->count_range_bytes = avl_snapshot_count_range_bytes;
+    snapshot->size = avl_snapshot_size;
+    snapshot->range = avl_snapshot_range;
+    snapshot->free = avl_snapshot_free;
+
+    return snapshot;
+}
+
+
+static tree_node* avl_snapshot_find(AVLSnapshot *self, const avl_key *key, bool greater, bool inclusive, bool exact) {
+    avl_check_key_type(self->tree, key);
+
+    return exact ? avl_search_node(self->tree, self->root, key) : avl_bound_node(self->tree, self->root, key, greater, inclusive);
+}
+
+
+static inline tree_node* avl_snapshot_lookup(AVLSnapshot *self, int64_t key) {
+    avl_key probe = avl_int_key(key);
+    return avl_snapshot_find(self, &probe, false, true, true);
+}
+
+
+static inline tree_node* avl_snapshot_lookup_bytes(AVLSnapshot *self, const void *key, size_t key_len) {
+    avl_key probe = avl_bytes_key(key, key_len);
+    return avl_snapshot_find(self, &probe, false, true, true);
+}
+
+
+static inline tree_node* avl_snapshot_min(AVLSnapshot *self) {
+    return get_min_node(self->root);
+}
+
+
+static inline tree_node* avl_snapshot_max(AVLSnapshot *self) {
+    return get_max_node(self->root);
+}
+
+
+static inline tree_node* avl_snapshot_floor(AVLSnapshot *self, int64_t key) {
+    avl_key probe = avl_int_key(key);
+    return avl_snapshot_find(self, &probe, false, true, false);
+}
+
+
+static inline tree_node* avl_snapshot_floor_bytes(AVLSnapshot *self, const void *key, size_t key_len) {
+    avl_key probe = avl_bytes_key(key, key_len);
+    return avl_snapshot_find(self, &probe, false, true, false);
+}
+
+
+static inline tree_node* avl_snapshot_ceiling(AVLSnapshot *self, int64_t key) {
+    avl_key probe = avl_int_key(key);
+    return avl_snapshot_find(self, &probe, true, true, false);
+}
+
+
+static inline tree_node* avl_snapshot_ceiling_bytes(AVLSnapshot *self, const void *key, size_t key_len) {
+    avl_key probe = avl_bytes_key(key, key_len);
+    return avl_snapshot_find(self, &probe, true, true, false);
+}
+
+
+static size_t avl_snapshot_rank_key(AVLSnapshot *self, const avl_key *key) {
+    avl_check_key_type(self->tree, key);
+
+    return avl_rank_node(self->tree, self->root, key);
+}
+
+
+static inline size_t avl_snapshot_rank(AVLSnapshot *self, int64_t key) {
+    avl_key probe = avl_int_key(key);
+    return avl_snapshot_rank_key(self, &probe);
+}
+
+
+static inline size_t avl_snapshot_rank_bytes(AVLSnapshot *self, const void *key, size_t key_len) {
+    avl_key probe = avl_bytes_key(key, key_len);
+    return avl_snapshot_rank_key(self, &probe);
+}
+
+
+static inline tree_node* avl_snapshot_select(AVLSnapshot *self, size_t k) {
+    return avl_select_node(self->root, k);
+}
+
+
+static inline size_t avl_snapshot_count_range(AVLSnapshot *self, int64_t lo, int64_t hi) {
+    avl_key lo_probe = avl_int_key(lo);
+    avl_key hi_probe = avl_int_key(hi);
+    return avl_count_between(self->tree, self->root, &lo_probe, &hi_probe);
+}
+
+
+static inline size_t avl_snapshot_count_range_bytes(AVLSnapshot *self, const void *lo, size_t lo_len, const void *hi, size_t hi_len) {
+    avl_key lo_probe = avl_bytes_key(lo, lo_len);
+    avl_key hi_probe = avl_bytes_key(hi, hi_len);
+    return avl_count_between(self->tree, self->root, &lo_probe, &hi_probe);
+}
+
+
+static inline size_t avl_snapshot_size(AVLSnapshot *self) {
+    return tree_node_count(self->root);
+}
+
+
+static void avl_snapshot_range(AVLSnapshot *self, int64_t lo, int64_t hi, void (*func)(int64_t key, void *data, va_list args), ...) {
+    avl_key probe = avl_int_key(lo);
+    avl_check_key_type(self->tree, &probe);
+
+    va_list args;
+    va_start(args, func);
+
+    avl_range_walk(self->root, lo, hi, func, &args);
+
+    va_end(args);
+}
+
+
+static void avl_snapshot_free(AVLSnapshot *self) {
+    AVL_Tree *tree = self->tree;
+
+    avl_write_lock(tree);
+
+    if (self->prev)
+        self->prev->next = self->next;
+    else
+        tree->oldest = self->next;
+
+    if (self->next)
+        self->next->prev = self->prev;
+    else
+        tree->newest = self->prev;
+
+    __atomic_sub_fetch(&tree->snapshots, 1, __ATOMIC_ACQ_REL);
+    epoch_bag_reclaim(&tree->retired, tree->oldest ? tree->oldest->epoch : UINT64_MAX);
+
+    RW_UNLOCK(tree->lock);
+
+    free(self);
+}
+
+
+static inline void avl_pin(AVL_Tree *self) {
+    READ_LOCK(self->lock);
+    avl_hold(self);
+}
+
+
+static inline void avl_unpin(AVL_Tree *self) {
+    avl_release(self);
+    RW_UNLOCK(self->lock);
+}
+
+
+static void avl_free_subtree(AVL_Tree *self, tree_node *node) {
+    if (!node)
+        return;
+
+    avl_free_subtree(self, node->left);
+    avl_free_subtree(self, node->right);
+
+    avl_release_data(self, node->data, node->adopted);
+}
+
+
+static void avl_retire_subtree(AVL_Tree *self, tree_node *node) {
+    if (!node)
+        return;
+
+    avl_retire_subtree(self, node->left);
+    avl_retire_subtree(self, node->right);
+
+    avl_release_key(self, node);
+    avl_release_data(self, node->data, node->adopted);
+    avl_retire(self, avl_reclaim_node, node);
+}
+
+
+static void avl_release_node_data(void *ctx, void *node) {
+    AVL_Tree *self = (AVL_Tree*) ctx;
+
+    avl_release_key(self, (tree_node*) node);
+    avl_release_data(self, ((tree_node*) node)->data, ((tree_node*) node)->adopted);
+}
+
+
+static void avl_clear(AVL_Tree *self) {
+    if (!self->arena)
+        node_pool_foreach(&self->pool, avl_release_node_data, self);
+    else if (self->adopted_count > 0)
+        avl_free_subtree(self, self->root);
+
+    node_pool_destroy(&self->pool);
+    free(self->bulk);
+
+    self->root = NULL;
+    self->adopted_count = 0;
+    self->bulk = NULL;
+    self->bulk_bytes = 0;
+    self->version++;
+}
+
+
+static void avl_free(AVL_Tree *self) {
+    avl_write_lock(self);
+
+    if (__atomic_load_n(&self->snapshots, __ATOMIC_ACQUIRE) > 0) {
+        fprintf(stderr, "AVL_Tree freed with live snapshots\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (self->persistent)
+        epoch_drain(&self->retired);
+
+    avl_clear(self);
+    
+    RW_UNLOCK(self->lock);
+    pthread_rwlock_destroy(&self->lock);
+    pthread_mutex_destroy(&self->snapshots_mutex);
+    
+    free(self);
+}
@@ -11,22 +11,33 @@ typedef struct ArrayList {
     struct ArrayList *self;
 
     void **arr;
+    bool *adopted;
     size_t capacity;
 
+    void (*destructor)(void *data);
+
     pthread_mutex_t mutex;
     pthread_mutexattr_t mutex_attr;
 
     void (*set_at)(struct ArrayList *self, void *data, size_t type_size, size_t index);
+    void (*adopt_at)(struct ArrayList *self, void *data, size_t type_size, size_t index);
     void* (*get_at)(struct ArrayList *self, size_t index);
+    void* (*steal_at)(struct ArrayList *self, size_t index);
     void (*foreach)(struct ArrayList *self, void (*func)(void *data, va_list args), ...);
+    void (*set_destructor)(struct ArrayList *self, void (*destructor)(void *data));
     void (*free)(struct ArrayList *self);
 } ArrayList;
 
 
 ArrayList* New_ArrayList();
+static void ArrayList_reserve(ArrayList *self, size_t index);
+static inline void ArrayList_store_at(ArrayList *self, void *data, bool adopted, size_t index);
 static inline void ArrayList_set_at(ArrayList *self, void *data, size_t type_size, size_t index);
+static inline void ArrayList_adopt_at(ArrayList *self, void *data, size_t type_size, size_t index);
 static inline void* ArrayList_get_at(ArrayList *self, size_t index);
+static inline void* ArrayList_steal_at(ArrayList *self, size_t index);
 static void ArrayList_foreach(ArrayList *self, void (*func)(void *data, va_list args), ...);
+static inline void ArrayList_set_destructor(ArrayList *self, void (*destructor)(void *data));
 static inline void ArrayList_free(ArrayList *self);
 
 
@@ -45,41 +56,81 @@ ArrayList* New_ArrayList() {
 
     self->capacity = ARRAY_LIST_INITIAL_CAPACITY;
     self->arr = (void**) calloc(self->capacity, sizeof(void*));
+    self->adopted = (bool*) calloc(self->capacity, sizeof(bool));
     
-    if (!self->arr)
+    if (!self->arr || !self->adopted)
         throw_memory_allocation_error();
 
+    self->destructor = free;
+
     self->set_at = ArrayList_set_at;
+    self->adopt_at = ArrayList_adopt_at;
     self->get_at = ArrayList_get_at;
+    self->steal_at = ArrayList_steal_at;
     self->foreach = ArrayList_foreach;
+    self->set_destructor = ArrayList_set_destructor;
     self->free = ArrayList_free;
 
     return self;
 }
 
 
+static void ArrayList_reserve(ArrayList *self, size_t index) {
+    if (index < self->capacity)
+        return;
+
+    size_t new_capacity = self->capacity * 2;
+
+    while (index >= new_capacity)
+        new_capacity *= 2;
+
+    void **new_arr = (void**) realloc(self->arr, new_capacity * sizeof(void*));
+
+    if (!new_arr)
+        throw_memory_allocation_error();
+
+    self->arr = new_arr;
+
+    bool *new_adopted = (bool*) realloc(self->adopted, new_capacity * sizeof(bool));
+
+    if (!new_adopted)
+        throw_memory_allocation_error();
+
+    self->adopted = new_adopted;
+
+    memset(new_arr + self->capacity, 0, (new_capacity - self->capacity) * sizeof(void*));
+    memset(new_adopted + self->capacity, 0, (new_capacity - self->capacity) * sizeof(bool));
+
+    self->capacity = new_capacity;
+}
+
+
+static inline void ArrayList_store_at(ArrayList *self, void *data, bool adopted, size_t index) {
+    ArrayList_reserve(self, index);
+
+    if (self->arr[index])
+        release_data(self->arr[index], self->adopted[index], self->destructor);
+
+    self->arr[index] = data;
+    self->adopted[index] = adopted;
+}
+
+
 static inline void ArrayList_set_at(ArrayList *self, void *data, size_t type_size, size_t index) {
     LOCK(self->mutex);
 
-    if (index >= self->capacity) {
-        size_t new_capacity = self->capacity * 2;
+    ArrayList_store_at(self, copy_from_void_ptr(data, type_size), false, index);
 
-        while (index >= new_capacity)
-            new_capacity *= 2;
+    UNLOCK(self->mutex);
+}
 
-        void **new_arr = (void**) realloc(self->arr, new_capacity * sizeof(void*));
-        
-        if (!new_arr)
-            throw_memory_allocation_error();
 
-        memset(new_arr + self->capacity, 0, (new_capacity - self->capacity) * sizeof(void*));
+static inline void ArrayList_adopt_at(ArrayList *self, void *data, size_t type_size, size_t index) {
+    (void) type_size;
 
-        self->arr = new_arr;
-        self->capacity = new_capacity;
-    }
+    LOCK(self->mutex);
 
-    free(self->arr[index]);
-    self->arr[index] = copy_from_void_ptr(data, type_size);
+    ArrayList_store_at(self, data, true, index);
 
     UNLOCK(self->mutex);
 }
@@ -99,6 +150,23 @@ static inline void* ArrayList_get_at(ArrayList *self, size_t index) {
 }
 
 
+static inline void* ArrayList_steal_at(ArrayList *self, size_t index) {
+    LOCK(self->mutex);
+
+    void *val = NULL;
+
+    if (index < self->capacity) {
+        val = self->arr[index];
+        self->arr[index] = NULL;
+        self->adopted[index] = false;
+    }
+
+    UNLOCK(self->mutex);
+
+    return val;
+}
+
+
 static void ArrayList_foreach(ArrayList *self, void (*func)(void *data, va_list args), ...) {
     LOCK(self->mutex);
 
@@ -123,13 +191,25 @@ static void ArrayList_foreach(ArrayList *self, void (*func)(void *data, va_list
 }
 
 
+static inline void ArrayList_set_destructor(ArrayList *self, void (*destructor)(void *data)) {
+    LOCK(self->mutex);
+
+    self->destructor = destructor;
+
+    UNLOCK(self->mutex);
+}
+
+
 static inline void ArrayList_free(ArrayList *self) {
     LOCK(self->mutex);
     
-    for (size_t i=0; i<self->capacity; ++i)
-        free(self->arr[i]);
+    for (size_t i=0; i<self->capacity; ++i) {
+        if (self->arr[i])
+            release_data(self->arr[i], self->adopted[i], self->destructor);
+    }
 
     free(self->arr);
+    free(self->adopted);
 
     UNLOCK(self->mutex);
 
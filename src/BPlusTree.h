@@ -0,0 +1,602 @@
+#pragma once
+
+
+#include "./internals.h"
+
+
+#define BPLUS_TREE_ORDER 32
+#define BPLUS_TREE_MIN_KEYS (BPLUS_TREE_ORDER / 2)
+#define BPLUS_TREE_MAX_DEPTH 32
+#define BPLUS_TREE_CACHE_LINE 64
+#define BPLUS_TREE_PAD_KEY INT64_MAX
+
+
+typedef struct bpt_node {
+    int64_t keys[BPLUS_TREE_ORDER];
+    uint32_t len;
+    bool leaf;
+} __attribute__((aligned(BPLUS_TREE_CACHE_LINE))) bpt_node;
+
+
+typedef struct bpt_inner {
+    bpt_node base;
+    bpt_node *children[BPLUS_TREE_ORDER + 1];
+} bpt_inner;
+
+
+typedef struct bpt_leaf {
+    bpt_node base;
+    uint64_t adopted;
+
+    struct bpt_leaf *next;
+    struct bpt_leaf *prev;
+
+    void *values[BPLUS_TREE_ORDER];
+} bpt_leaf;
+
+
+typedef struct BPlusTree {
+    struct BPlusTree *self;
+
+    bpt_node *root;
+    size_t len;
+    size_t depth;
+
+    void (*destructor)(void *data);
+
+    pthread_rwlock_t lock;
+
+    void (*insert)(struct BPlusTree *self, int64_t key, void *data, size_t type_size);
+    void (*adopt)(struct BPlusTree *self, int64_t key, void *data, size_t type_size);
+    void (*delete)(struct BPlusTree *self, int64_t key);
+    void* (*steal)(struct BPlusTree *self, int64_t key);
+    // lookup returns the stored pointer, valid until that key is deleted or overwritten.
+    void* (*lookup)(struct BPlusTree *self, int64_t key);
+    // range visits keys in [lo, hi), matching AVL_Tree. func runs under the read lock and must not modify the tree.
+    void (*range)(struct BPlusTree *self, int64_t lo, int64_t hi, void (*func)(int64_t key, void *data, va_list args), ...);
+    size_t (*size)(struct BPlusTree *self);
+    void (*set_destructor)(struct BPlusTree *self, void (*destructor)(void *data));
+    void (*free)(struct BPlusTree *self);
+} BPlusTree;
+
+
+BPlusTree* New_BPlusTree();
+static void* bpt_alloc_node(size_t size, bool leaf);
+static inline size_t bpt_count_less(const int64_t *keys, int64_t key);
+static inline size_t bpt_child_index(const bpt_node *node, int64_t key);
+static bpt_leaf* bpt_find_leaf(const BPlusTree *self, int64_t key, bpt_inner **path, size_t *slots);
+static void bpt_leaf_insert_at(bpt_leaf *leaf, size_t pos, int64_t key, void *data, bool adopted);
+static void bpt_leaf_remove_at(bpt_leaf *leaf, size_t pos);
+static void bpt_inner_insert_at(bpt_inner *node, size_t pos, int64_t key, bpt_node *child);
+static void bpt_inner_remove_at(bpt_inner *node, size_t pos);
+static void bpt_insert_parent(BPlusTree *self, bpt_inner **path, size_t *slots, size_t depth, int64_t key, bpt_node *child);
+static void bpt_insert_data(BPlusTree *self, int64_t key, void *data, bool adopted);
+static void bpt_fix_underflow(BPlusTree *self, bpt_inner **path, size_t *slots, size_t depth);
+static bool bpt_remove(BPlusTree *self, int64_t key, void **data, bool *adopted);
+static void bplus_tree_insert(BPlusTree *self, int64_t key, void *data, size_t type_size);
+static void bplus_tree_adopt(BPlusTree *self, int64_t key, void *data, size_t type_size);
+static void bplus_tree_delete(BPlusTree *self, int64_t key);
+static void* bplus_tree_steal(BPlusTree *self, int64_t key);
+static void* bplus_tree_lookup(BPlusTree *self, int64_t key);
+static void bplus_tree_range(BPlusTree *self, int64_t lo, int64_t hi, void (*func)(int64_t key, void *data, va_list args), ...);
+static size_t bplus_tree_size(BPlusTree *self);
+static void bplus_tree_set_destructor(BPlusTree *self, void (*destructor)(void *data));
+static void bpt_free_subtree(BPlusTree *self, bpt_node *node);
+static void bplus_tree_free(BPlusTree *self);
+
+
+BPlusTree* New_BPlusTree() {
+    BPlusTree *self = (BPlusTree*) malloc(sizeof(BPlusTree));
+
+    if (!self)
+        throw_memory_allocation_error();
+
+    self->self = self;
+
+    self->root = (bpt_node*) bpt_alloc_node(sizeof(bpt_leaf), true);
+    self->len = 0;
+    self->depth = 0;
+    self->destructor = free;
+
+    pthread_rwlock_init(&self->lock, NULL);
+
+    self->insert = bplus_tree_insert;
+    self->adopt = bplus_tree_adopt;
+    self->delete = bplus_tree_delete;
+    self->steal = bplus_tree_steal;
+    self->lookup = bplus_tree_lookup;
+    self->range = bplus_tree_range;
+    self->size = bplus_tree_size;
+    self->set_destructor = bplus_tree_set_destructor;
+    self->free = bplus_tree_free;
+
+    return self;
+}
+
+
+static void* bpt_alloc_node(size_t size, bool leaf) {
+    bpt_node *node;
+
+    if (posix_memalign((void**) &node, BPLUS_TREE_CACHE_LINE, size) != 0)
+        throw_memory_allocation_error();
+
+    memset(node, 0, size);
+
+    for (size_t i=0; i<BPLUS_TREE_ORDER; ++i)
+        node->keys[i] = BPLUS_TREE_PAD_KEY;
+
+    node->leaf = leaf;
+
+    return node;
+}
+
+
+static inline size_t bpt_count_less(const int64_t *keys, int64_t key) {
+    size_t count = 0;
+
+    for (size_t i=0; i<BPLUS_TREE_ORDER; ++i)
+        count += keys[i] < key;
+
+    return count;
+}
+
+
+static inline size_t bpt_child_index(const bpt_node *node, int64_t key) {
+    if (key == BPLUS_TREE_PAD_KEY)
+        return node->len;
+    return bpt_count_less(node->keys, key + 1);
+}
+
+
+static bpt_leaf* bpt_find_leaf(const BPlusTree *self, int64_t key, bpt_inner **path, size_t *slots) {
+    bpt_node *node = self->root;
+
+    for (size_t depth=0; !node->leaf; ++depth) {
+        size_t slot = bpt_child_index(node, key);
+
+        if (path) {
+            path[depth] = (bpt_inner*) node;
+            slots[depth] = slot;
+        }
+
+        node = ((bpt_inner*) node)->children[slot];
+    }
+
+    return (bpt_leaf*) node;
+}
+
+
+static void bpt_leaf_insert_at(bpt_leaf *leaf, size_t pos, int64_t key, void *data, bool adopted) {
+    size_t len = leaf->base.len;
+    uint64_t mask = (1ULL << pos) - 1;
+
+    memmove(&leaf->base.keys[pos + 1], &leaf->base.keys[pos], (len - pos) * sizeof(int64_t));
+    memmove(&leaf->values[pos + 1], &leaf->values[pos], (len - pos) * sizeof(void*));
+
+    leaf->adopted = (leaf->adopted & mask) | ((leaf->adopted & ~mask) << 1) | ((uint64_t) adopted << pos);
+    leaf->base.keys[pos] = key;
+    leaf->values[pos] = data;
+    leaf->base.len++;
+}
+
+
+static void bpt_leaf_remove_at(bpt_leaf *leaf, size_t pos) {
+    size_t len = leaf->base.len;
+    uint64_t mask = (1ULL << pos) - 1;
+
+    memmove(&leaf->base.keys[pos], &leaf->base.keys[pos + 1], (len - pos - 1) * sizeof(int64_t));
+    memmove(&leaf->values[pos], &leaf->values[pos + 1], (len - pos - 1) * sizeof(void*));
+
+    leaf->adopted = (leaf->adopted & mask) | ((leaf->adopted >> 1) & ~mask);
+    leaf->base.keys[len - 1] = BPLUS_TREE_PAD_KEY;
+    leaf->values[len - 1] = NULL;
+    leaf->base.len--;
+}
+
+
+static void bpt_inner_insert_at(bpt_inner *node, size_t pos, int64_t key, bpt_node *child) {
+    size_t len = node->base.len;
+
+    memmove(&node->base.keys[pos + 1], &node->base.keys[pos], (len - pos) * sizeof(int64_t));
+    memmove(&node->children[pos + 2], &node->children[pos + 1], (len - pos) * sizeof(bpt_node*));
+
+    node->base.keys[pos] = key;
+    node->children[pos + 1] = child;
+    node->base.len++;
+}
+
+
+static void bpt_inner_remove_at(bpt_inner *node, size_t pos) {
+    size_t len = node->base.len;
+
+    memmove(&node->base.keys[pos], &node->base.keys[pos + 1], (len - pos - 1) * sizeof(int64_t));
+    memmove(&node->children[pos + 1], &node->children[pos + 2], (len - pos - 1) * sizeof(bpt_node*));
+
+    node->base.keys[len - 1] = BPLUS_TREE_PAD_KEY;
+    node->children[len] = NULL;
+    node->base.len--;
+}
+
+
+static void bpt_insert_parent(BPlusTree *self, bpt_inner **path, size_t *slots, size_t depth, int64_t key, bpt_node *child) {
+    while (depth > 0) {
+        bpt_inner *parent = path[depth - 1];
+        size_t pos = slots[depth - 1];
+
+        if (parent->base.len < BPLUS_TREE_ORDER) {
+            bpt_inner_insert_at(parent, pos, key, child);
+            return;
+        }
+
+        int64_t keys[BPLUS_TREE_ORDER + 1];
+        bpt_node *children[BPLUS_TREE_ORDER + 2];
+
+        memcpy(keys, parent->base.keys, pos * sizeof(int64_t));
+        keys[pos] = key;
+        memcpy(keys + pos + 1, parent->base.keys + pos, (BPLUS_TREE_ORDER - pos) * sizeof(int64_t));
+
+        memcpy(children, parent->children, (pos + 1) * sizeof(bpt_node*));
+        children[pos + 1] = child;
+        memcpy(children + pos + 2, parent->children + pos + 1, (BPLUS_TREE_ORDER - pos) * sizeof(bpt_node*));
+
+        size_t mid = (BPLUS_TREE_ORDER + 1) / 2;
+        bpt_inner *right = (bpt_inner*) bpt_alloc_node(sizeof(bpt_inner), false);
+
+        for (size_t i=0; i<BPLUS_TREE_ORDER; ++i)
+            parent->base.keys[i] = i < mid ? keys[i] : BPLUS_TREE_PAD_KEY;
+
+        memcpy(parent->children, children, (mid + 1) * sizeof(bpt_node*));
+        memset(parent->children + mid + 1, 0, (BPLUS_TREE_ORDER - mid) * sizeof(bpt_node*));
+        parent->base.len = mid;
+
+        right->base.len = BPLUS_TREE_ORDER - mid;
+        memcpy(right->base.keys, keys + mid + 1, right->base.len * sizeof(int64_t));
+        memcpy(right->children, children + mid + 1, (right->base.len + 1) * sizeof(bpt_node*));
+
+        key = keys[mid];
+        child = (bpt_node*) right;
+        depth--;
+    }
+
+    bpt_inner *root = (bpt_inner*) bpt_alloc_node(sizeof(bpt_inner), false);
+
+    root->base.keys[0] = key;
+    root->base.len = 1;
+    root->children[0] = self->root;
+    root->children[1] = child;
+
+    self->root = (bpt_node*) root;
+    self->depth++;
+}
+
+
+static void bpt_insert_data(BPlusTree *self, int64_t key, void *data, bool adopted) {
+    bpt_inner *path[BPLUS_TREE_MAX_DEPTH];
+    size_t slots[BPLUS_TREE_MAX_DEPTH];
+
+    bpt_leaf *leaf = bpt_find_leaf(self, key, path, slots);
+    size_t pos = bpt_count_less(leaf->base.keys, key);
+
+    if (pos < leaf->base.len && leaf->base.keys[pos] == key) {
+        if (leaf->values[pos])
+            release_data(leaf->values[pos], (leaf->adopted >> pos) & 1, self->destructor);
+
+        leaf->values[pos] = data;
+        leaf->adopted = (leaf->adopted & ~(1ULL << pos)) | ((uint64_t) adopted << pos);
+        return;
+    }
+
+    self->len++;
+
+    if (leaf->base.len < BPLUS_TREE_ORDER) {
+        bpt_leaf_insert_at(leaf, pos, key, data, adopted);
+        return;
+    }
+
+    size_t mid = BPLUS_TREE_ORDER / 2;
+    bpt_leaf *right = (bpt_leaf*) bpt_alloc_node(sizeof(bpt_leaf), true);
+
+    right->base.len = BPLUS_TREE_ORDER - mid;
+    memcpy(right->base.keys, leaf->base.keys + mid, right->base.len * sizeof(int64_t));
+    memcpy(right->values, leaf->values + mid, right->base.len * sizeof(void*));
+    right->adopted = leaf->adopted >> mid;
+
+    for (size_t i=mid; i<BPLUS_TREE_ORDER; ++i) {
+        leaf->base.keys[i] = BPLUS_TREE_PAD_KEY;
+        leaf->values[i] = NULL;
+    }
+
+    leaf->adopted &= (1ULL << mid) - 1;
+    leaf->base.len = mid;
+
+    right->next = leaf->next;
+    right->prev = leaf;
+
+    if (leaf->next)
+        leaf->next->prev = right;
+
+    leaf->next = right;
+
+    if (pos <= mid)
+        bpt_leaf_insert_at(leaf, pos, key, data, adopted);
+    else
+        bpt_leaf_insert_at(right, pos - mid, key, data, adopted);
+
+    bpt_insert_parent(self, path, slots, self->depth, right->base.keys[0], (bpt_node*) right);
+}
+
+
+static void bpt_fix_underflow(BPlusTree *self, bpt_inner **path, size_t *slots, size_t depth) {
+    bpt_node *node = depth > 0 ? path[depth - 1]->children[slots[depth - 1]] : self->root;
+
+    while (depth > 0 && node->len < BPLUS_TREE_MIN_KEYS) {
+        bpt_inner *parent = path[depth - 1];
+        size_t slot = slots[depth - 1];
+        bpt_node *left = slot > 0 ? parent->children[slot - 1] : NULL;
+        bpt_node *right = slot < parent->base.len ? parent->children[slot + 1] : NULL;
+
+        if (left && left->len > BPLUS_TREE_MIN_KEYS) {
+            if (node->leaf) {
+                bpt_leaf *from = (bpt_leaf*) left;
+                size_t last = from->base.len - 1;
+                bool adopted = (from->adopted >> last) & 1;
+
+                bpt_leaf_insert_at((bpt_leaf*) node, 0, from->base.keys[last], from->values[last], adopted);
+                bpt_leaf_remove_at(from, last);
+                parent->base.keys[slot - 1] = node->keys[0];
+            } else {
+                bpt_inner *to = (bpt_inner*) node;
+                bpt_inner *from = (bpt_inner*) left;
+
+                memmove(&to->base.keys[1], &to->base.keys[0], to->base.len * sizeof(int64_t));
+                memmove(&to->children[1], &to->children[0], (to->base.len + 1) * sizeof(bpt_node*));
+
+                to->base.keys[0] = parent->base.keys[slot - 1];
+                to->children[0] = from->children[from->base.len];
+                to->base.len++;
+
+                parent->base.keys[slot - 1] = from->base.keys[from->base.len - 1];
+                from->base.keys[from->base.len - 1] = BPLUS_TREE_PAD_KEY;
+                from->children[from->base.len] = NULL;
+                from->base.len--;
+            }
+
+            return;
+        }
+
+        if (right && right->len > BPLUS_TREE_MIN_KEYS) {
+            if (node->leaf) {
+                bpt_leaf *from = (bpt_leaf*) right;
+                bool adopted = from->adopted & 1;
+
+                bpt_leaf_insert_at((bpt_leaf*) node, node->len, from->base.keys[0], from->values[0], adopted);
+                bpt_leaf_remove_at(from, 0);
+                parent->base.keys[slot] = from->base.keys[0];
+            } else {
+                bpt_inner *to = (bpt_inner*) node;
+                bpt_inner *from = (bpt_inner*) right;
+
+                to->base.keys[to->base.len] = parent->base.keys[slot];
+                to->children[to->base.len + 1] = from->children[0];
+                to->base.len++;
+
+                parent->base.keys[slot] = from->base.keys[0];
+
+                memmove(&from->base.keys[0], &from->base.keys[1], (from->base.len - 1) * sizeof(int64_t));
+                memmove(&from->children[0], &from->children[1], from->base.len * sizeof(bpt_node*));
+
+                from->base.keys[from->base.len - 1] = BPLUS_TREE_PAD_KEY;
+                from->children[from->base.len] = NULL;
+                from->base.len--;
+            }
+
+            return;
+        }
+
+        size_t sep = left ? slot - 1 : slot;
+        bpt_node *into = left ? left : node;
+        bpt_node *from = left ? node : right;
+
+        if (into->leaf) {
+            bpt_leaf *a = (bpt_leaf*) into;
+            bpt_leaf *b = (bpt_leaf*) from;
+
+            memcpy(&a->base.keys[a->base.len], b->base.keys, b->base.len * sizeof(int64_t));
+            memcpy(&a->values[a->base.len], b->values, b->base.len * sizeof(void*));
+            a->adopted |= b->adopted << a->base.len;
+            a->base.len += b->base.len;
+
+            a->next = b->next;
+
+            if (b->next)
+                b->next->prev = a;
+        } else {
+            bpt_inner *a = (bpt_inner*) into;
+            bpt_inner *b = (bpt_inner*) from;
+
+            a->base.keys[a->base.len] = parent->base.keys[sep];
+            memcpy(&a->base.keys[a->base.len + 1], b->base.keys, b->base.len * sizeof(int64_t));
+            memcpy(&a->children[a->base.len + 1], b->children, (b->base.len + 1) * sizeof(bpt_node*));
+            a->base.len += b->base.len + 1;
+        }
+
+        free(from);
+        bpt_inner_remove_at(parent, sep);
+
+        node = (bpt_node*) parent;
+        depth--;
+    }
+
+    if (!self->root->leaf && self->root->len == 0) {
+        bpt_node *old = self->root;
+
+        self->root = ((bpt_inner*) old)->children[0];
+        self->depth--;
+
+        free(old);
+    }
+}
+
+
+static bool bpt_remove(BPlusTree *self, int64_t key, void **data, bool *adopted) {
+    bpt_inner *path[BPLUS_TREE_MAX_DEPTH];
+    size_t slots[BPLUS_TREE_MAX_DEPTH];
+
+    bpt_leaf *leaf = bpt_find_leaf(self, key, path, slots);
+    size_t pos = bpt_count_less(leaf->base.keys, key);
+
+    if (pos >= leaf->base.len || leaf->base.keys[pos] != key)
+        return false;
+
+    *data = leaf->values[pos];
+    *adopted = (leaf->adopted >> pos) & 1;
+
+    bpt_leaf_remove_at(leaf, pos);
+    self->len--;
+
+    bpt_fix_underflow(self, path, slots, self->depth);
+
+    return true;
+}
+
+
+static void bplus_tree_insert(BPlusTree *self, int64_t key, void *data, size_t type_size) {
+    WRITE_LOCK(self->lock);
+
+    bpt_insert_data(self, key, copy_from_void_ptr(data, type_size), false);
+
+    RW_UNLOCK(self->lock);
+}
+
+
+static void bplus_tree_adopt(BPlusTree *self, int64_t key, void *data, size_t type_size) {
+    (void) type_size;
+
+    WRITE_LOCK(self->lock);
+
+    bpt_insert_data(self, key, data, true);
+
+    RW_UNLOCK(self->lock);
+}
+
+
+static void bplus_tree_delete(BPlusTree *self, int64_t key) {
+    WRITE_LOCK(self->lock);
+
+    void *data = NULL;
+    bool adopted = false;
+
+    if (bpt_remove(self, key, &data, &adopted) && data)
+        release_data(data, adopted, self->destructor);
+
+    RW_UNLOCK(self->lock);
+}
+
+
+static void* bplus_tree_steal(BPlusTree *self, int64_t key) {
+    WRITE_LOCK(self->lock);
+
+    void *data = NULL;
+    bool adopted = false;
+
+    bpt_remove(self, key, &data, &adopted);
+
+    RW_UNLOCK(self->lock);
+
+    return data;
+}
+
+
+static void* bplus_tree_lookup(BPlusTree *self, int64_t key) {
+    READ_LOCK(self->lock);
+
+    bpt_leaf *leaf = bpt_find_leaf(self, key, NULL, NULL);
+    size_t pos = bpt_count_less(leaf->base.keys, key);
+    void *res = NULL;
+
+    if (pos < leaf->base.len && leaf->base.keys[pos] == key)
+        res = leaf->values[pos];
+
+    RW_UNLOCK(self->lock);
+
+    return res;
+}
+
+
+static void bplus_tree_range(BPlusTree *self, int64_t lo, int64_t hi, void (*func)(int64_t key, void *data, va_list args), ...) {
+    READ_LOCK(self->lock);
+
+    va_list args;
+    va_start(args, func);
+
+    bpt_leaf *leaf = bpt_find_leaf(self, lo, NULL, NULL);
+    size_t pos = bpt_count_less(leaf->base.keys, lo);
+
+    for (; leaf; leaf=leaf->next, pos=0) {
+        for (; pos<leaf->base.len; ++pos) {
+            if (leaf->base.keys[pos] >= hi)
+                goto done;
+
+            va_list args_copy;
+            va_copy(args_copy, args);
+            func(leaf->base.keys[pos], leaf->values[pos], args_copy);
+            va_end(args_copy);
+        }
+    }
+
+    done:
+        va_end(args);
+
+    RW_UNLOCK(self->lock);
+}
+
+
+static size_t bplus_tree_size(BPlusTree *self) {
+    READ_LOCK(self->lock);
+
+    size_t len = self->len;
+
+    RW_UNLOCK(self->lock);
+
+    return len;
+}
+
+
+static void bplus_tree_set_destructor(BPlusTree *self, void (*destructor)(void *data)) {
+    WRITE_LOCK(self->lock);
+
+    self->destructor = destructor;
+
+    RW_UNLOCK(self->lock);
+}
+
+
+static void bpt_free_subtree(BPlusTree *self, bpt_node *node) {
+    if (node->leaf) {
+        bpt_leaf *leaf = (bpt_leaf*) node;
+
+        for (size_t i=0; i<leaf->base.len; ++i) {
+            if (leaf->values[i])
+                release_data(leaf->values[i], (leaf->adopted >> i) & 1, self->destructor);
+        }
+    } else {
+        bpt_inner *inner = (bpt_inner*) node;
+
+        for (size_t i=0; i<=inner->base.len; ++i)
+            bpt_free_subtree(self, inner->children[i]);
+    }
+
+    free(node);
+}
+
+
+static void bplus_tree_free(BPlusTree *self) {
+    WRITE_LOCK(self->lock);
+
+    bpt_free_subtree(self, self->root);
+
+    RW_UNLOCK(self->lock);
+    pthread_rwlock_destroy(&self->lock);
+
+    free(self);
+}
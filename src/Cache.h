@@ -0,0 +1,403 @@
+#pragma once
+
+
+#include "./internals.h"
+#include "./HashTable.h"
+
+
+#define CACHE_DATA_ALIGN 16
+#define CACHE_NO_TTL 0
+
+
+typedef struct cache_node {
+    void *data;
+    size_t type_size;
+    size_t charge;
+    uint64_t expires_at;
+    uint64_t hash;
+    size_t key_len;
+
+    struct cache_node *next;
+    struct cache_node *prev;
+
+    char key[];
+} cache_node;
+
+
+typedef struct CacheStats {
+    size_t hits;
+    size_t misses;
+    size_t evictions;
+    size_t expirations;
+} CacheStats;
+
+
+// get returns the cached value in place, valid until the next put, delete_entry or eviction on this cache.
+// Call pin before get and unpin after the last use to keep it valid across those. put rejects values whose
+// key_len + type_size exceeds max_bytes and returns false.
+typedef struct Cache {
+    struct Cache *self;
+
+    ht_engine engine;
+
+    cache_node *head;
+    cache_node *tail;
+    size_t len;
+    size_t bytes;
+
+    size_t max_entries;
+    size_t max_bytes;
+
+    CacheStats stats_counters;
+
+    pthread_mutex_t mutex;
+    pthread_mutexattr_t mutex_attr;
+
+    void* (*get)(struct Cache *self, char *key);
+    void* (*get_bytes)(struct Cache *self, const void *key, size_t key_len);
+    bool (*put)(struct Cache *self, char *key, void *data, size_t type_size, uint64_t ttl_ms);
+    bool (*put_bytes)(struct Cache *self, const void *key, size_t key_len, void *data, size_t type_size, uint64_t ttl_ms);
+    bool (*touch)(struct Cache *self, char *key);
+    bool (*touch_bytes)(struct Cache *self, const void *key, size_t key_len);
+    bool (*delete_entry)(struct Cache *self, char *key);
+    bool (*delete_bytes)(struct Cache *self, const void *key, size_t key_len);
+    size_t (*size)(struct Cache *self);
+    CacheStats (*stats)(struct Cache *self);
+    void (*pin)(struct Cache *self);
+    void (*unpin)(struct Cache *self);
+    void (*free)(struct Cache *self);
+} Cache;
+
+
+Cache* New_Cache(size_t max_entries, size_t max_bytes);
+static inline uint64_t cache_now_ns();
+static cache_node* init_cache_node(const void *key, size_t key_len, uint64_t hash, void *data, size_t type_size, uint64_t ttl_ms);
+static inline void cache_link_front(Cache *self, cache_node *node);
+static inline void cache_unlink(Cache *self, cache_node *node);
+static void cache_remove_node(Cache *self, cache_node *node);
+static cache_node* cache_find(Cache *self, const void *key, size_t key_len, uint64_t hash);
+static void cache_evict(Cache *self);
+static inline void* cache_get(Cache *self, char *key);
+static void* cache_get_bytes(Cache *self, const void *key, size_t key_len);
+static inline bool cache_put(Cache *self, char *key, void *data, size_t type_size, uint64_t ttl_ms);
+static bool cache_put_bytes(Cache *self, const void *key, size_t key_len, void *data, size_t type_size, uint64_t ttl_ms);
+static inline bool cache_touch(Cache *self, char *key);
+static bool cache_touch_bytes(Cache *self, const void *key, size_t key_len);
+static inline bool cache_delete(Cache *self, char *key);
+static bool cache_delete_bytes(Cache *self, const void *key, size_t key_len);
+static size_t cache_size(Cache *self);
+static CacheStats cache_stats(Cache *self);
+static inline void cache_pin(Cache *self);
+static inline void cache_unpin(Cache *self);
+static void cache_free(Cache *self);
+
+
+Cache* New_Cache(size_t max_entries, size_t max_bytes) {
+    Cache *self = (Cache*) malloc(sizeof(Cache));
+
+    if (!self)
+        throw_memory_allocation_error();
+
+    self->self = self;
+
+    ht_engine_init(&self->engine);
+
+    self->head = NULL;
+    self->tail = NULL;
+    self->len = 0;
+    self->bytes = 0;
+
+    self->max_entries = max_entries;
+    self->max_bytes = max_bytes;
+
+    memset(&self->stats_counters, 0, sizeof(CacheStats));
+
+    pthread_mutexattr_init(&self->mutex_attr);
+    pthread_mutexattr_settype(&self->mutex_attr, PTHREAD_MUTEX_RECURSIVE);
+
+    pthread_mutex_init(&self->mutex, &self->mutex_attr);
+
+    pthread_mutexattr_destroy(&self->mutex_attr);
+
+    self->get = cache_get;
+    self->get_bytes = cache_get_bytes;
+    self->put = cache_put;
+    self->put_bytes = cache_put_bytes;
+    self->touch = cache_touch;
+    self->touch_bytes = cache_touch_bytes;
+    self->delete_entry = cache_delete;
+    self->delete_bytes = cache_delete_bytes;
+    self->size = cache_size;
+    self->stats = cache_stats;
+    self->pin = cache_pin;
+    self->unpin = cache_unpin;
+    self->free = cache_free;
+
+    return self;
+}
+
+
+static inline uint64_t cache_now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec;
+}
+
+
+static cache_node* init_cache_node(const void *key, size_t key_len, uint64_t hash, void *data, size_t type_size, uint64_t ttl_ms) {
+    size_t data_offset = (sizeof(cache_node) + key_len + 1 + CACHE_DATA_ALIGN - 1) & ~(size_t) (CACHE_DATA_ALIGN - 1);
+    cache_node *node = (cache_node*) malloc(data_offset + type_size);
+
+    if (!node)
+        throw_memory_allocation_error();
+
+    memcpy(node->key, key, key_len);
+    node->key[key_len] = '\0';
+
+    node->data = NULL;
+    node->type_size = type_size;
+    node->charge = key_len + type_size;
+    node->expires_at = ttl_ms == CACHE_NO_TTL ? 0 : cache_now_ns() + ttl_ms * 1000000ULL;
+    node->hash = hash;
+    node->key_len = key_len;
+    node->next = NULL;
+    node->prev = NULL;
+
+    if (data && type_size > 0) {
+        node->data = (char*) node + data_offset;
+        memcpy(node->data, data, type_size);
+    }
+
+    return node;
+}
+
+
+static inline void cache_link_front(Cache *self, cache_node *node) {
+    node->prev = NULL;
+    node->next = self->head;
+
+    if (self->head)
+        self->head->prev = node;
+    else
+        self->tail = node;
+
+    self->head = node;
+}
+
+
+static inline void cache_unlink(Cache *self, cache_node *node) {
+    if (node->prev)
+        node->prev->next = node->next;
+    else
+        self->head = node->next;
+
+    if (node->next)
+        node->next->prev = node->prev;
+    else
+        self->tail = node->prev;
+}
+
+
+static void cache_remove_node(Cache *self, cache_node *node) {
+    cache_unlink(self, node);
+
+    self->len--;
+    self->bytes -= node->charge;
+
+    ht_engine_erase(&self->engine, node->key, node->key_len, node->hash, NULL);
+}
+
+
+static cache_node* cache_find(Cache *self, const void *key, size_t key_len, uint64_t hash) {
+    Entry *entry = ht_engine_find(&self->engine, key, key_len, hash);
+
+    if (!entry)
+        return NULL;
+
+    cache_node *node = (cache_node*) entry->data;
+
+    if (node->expires_at != 0 && node->expires_at <= cache_now_ns()) {
+        cache_remove_node(self, node);
+        self->stats_counters.expirations++;
+        return NULL;
+    }
+
+    return node;
+}
+
+
+static void cache_evict(Cache *self) {
+    while (self->tail && ((self->max_entries && self->len > self->max_entries) || (self->max_bytes && self->bytes > self->max_bytes))) {
+        cache_remove_node(self, self->tail);
+        self->stats_counters.evictions++;
+    }
+}
+
+
+static inline void* cache_get(Cache *self, char *key) {
+    return cache_get_bytes(self, key, strlen(key));
+}
+
+
+static void* cache_get_bytes(Cache *self, const void *key, size_t key_len) {
+    uint64_t hash = ht_engine_hash(&self->engine, key, key_len);
+
+    LOCK(self->mutex);
+
+    void *res = NULL;
+    cache_node *node = cache_find(self, key, key_len, hash);
+
+    if (node) {
+        cache_unlink(self, node);
+        cache_link_front(self, node);
+
+        res = node->data;
+        self->stats_counters.hits++;
+    } else {
+        self->stats_counters.misses++;
+    }
+
+    UNLOCK(self->mutex);
+
+    return res;
+}
+
+
+static inline bool cache_put(Cache *self, char *key, void *data, size_t type_size, uint64_t ttl_ms) {
+    return cache_put_bytes(self, key, strlen(key), data, type_size, ttl_ms);
+}
+
+
+static bool cache_put_bytes(Cache *self, const void *key, size_t key_len, void *data, size_t type_size, uint64_t ttl_ms) {
+    uint64_t hash = ht_engine_hash(&self->engine, key, key_len);
+
+    if (self->max_bytes && key_len + type_size > self->max_bytes) {
+        LOCK(self->mutex);
+
+        Entry *stale = ht_engine_find(&self->engine, key, key_len, hash);
+
+        if (stale)
+            cache_remove_node(self, (cache_node*) stale->data);
+
+        UNLOCK(self->mutex);
+
+        return false;
+    }
+
+    cache_node *node = init_cache_node(key, key_len, hash, data, type_size, ttl_ms);
+
+    LOCK(self->mutex);
+
+    Entry *entry = ht_engine_find(&self->engine, key, key_len, hash);
+
+    if (entry) {
+        cache_node *old = (cache_node*) entry->data;
+
+        cache_unlink(self, old);
+        self->len--;
+        self->bytes -= old->charge;
+    }
+
+    ht_engine_insert(&self->engine, node->key, key_len, hash, node, sizeof(cache_node), true, true);
+
+    cache_link_front(self, node);
+    self->len++;
+    self->bytes += node->charge;
+
+    cache_evict(self);
+
+    UNLOCK(self->mutex);
+
+    return true;
+}
+
+
+static inline bool cache_touch(Cache *self, char *key) {
+    return cache_touch_bytes(self, key, strlen(key));
+}
+
+
+static bool cache_touch_bytes(Cache *self, const void *key, size_t key_len) {
+    uint64_t hash = ht_engine_hash(&self->engine, key, key_len);
+
+    LOCK(self->mutex);
+
+    cache_node *node = cache_find(self, key, key_len, hash);
+
+    if (node) {
+        cache_unlink(self, node);
+        cache_link_front(self, node);
+    }
+
+    UNLOCK(self->mutex);
+
+    return node != NULL;
+}
+
+
+static inline bool cache_delete(Cache *self, char *key) {
+    return cache_delete_bytes(self, key, strlen(key));
+}
+
+
+static bool cache_delete_bytes(Cache *self, const void *key, size_t key_len) {
+    uint64_t hash = ht_engine_hash(&self->engine, key, key_len);
+
+    LOCK(self->mutex);
+
+    Entry *entry = ht_engine_find(&self->engine, key, key_len, hash);
+
+    if (entry)
+        cache_remove_node(self, (cache_node*) entry->data);
+
+    UNLOCK(self->mutex);
+
+    return entry != NULL;
+}
+
+
+static size_t cache_size(Cache *self) {
+    LOCK(self->mutex);
+
+    size_t len = self->len;
+
+    UNLOCK(self->mutex);
+
+    return len;
+}
+
+
+static CacheStats cache_stats(Cache *self) {
+    LOCK(self->mutex);
+
+    CacheStats stats = self->stats_counters;
+
+    UNLOCK(self->mutex);
+
+    return stats;
+}
+
+
+static inline void cache_pin(Cache *self) {
+    (void) self;
+    epoch_enter();
+}
+
+
+static inline void cache_unpin(Cache *self) {
+    (void) self;
+    epoch_exit();
+}
+
+
+static void cache_free(Cache *self) {
+    LOCK(self->mutex);
+
+    ht_engine_destroy(&self->engine);
+
+    UNLOCK(self->mutex);
+    pthread_mutex_destroy(&self->mutex);
+
+    free(self);
+}
@@ -0,0 +1,188 @@
+#pragma once
+
+
+#include "./internals.h"
+#include "./HashTable.h"
+
+
+#ifndef CONCURRENT_HASH_TABLE_SHARD_BITS
+#define CONCURRENT_HASH_TABLE_SHARD_BITS 6
+#endif
+
+#define CONCURRENT_HASH_TABLE_SHARDS (1 << CONCURRENT_HASH_TABLE_SHARD_BITS)
+#define CONCURRENT_HASH_TABLE_CACHE_LINE 64
+
+
+typedef struct cht_shard {
+    pthread_mutex_t mutex;
+    ht_engine engine;
+} __attribute__((aligned(CONCURRENT_HASH_TABLE_CACHE_LINE))) cht_shard;
+
+
+typedef struct ConcurrentHashTable {
+    struct ConcurrentHashTable *self;
+
+    cht_shard *shards;
+    uint64_t seed;
+
+    void* (*get)(struct ConcurrentHashTable *self, char *key);
+    void (*set)(struct ConcurrentHashTable *self, char *key, void *data, size_t type_size);
+    void (*delete_entry)(struct ConcurrentHashTable *self, char *key);
+    void* (*get_bytes)(struct ConcurrentHashTable *self, const void *key, size_t key_len, const uint64_t *hash);
+    void (*set_bytes)(struct ConcurrentHashTable *self, const void *key, size_t key_len, const uint64_t *hash, void *data, size_t type_size);
+    void (*delete_bytes)(struct ConcurrentHashTable *self, const void *key, size_t key_len, const uint64_t *hash);
+    uint64_t (*hash)(struct ConcurrentHashTable *self, const void *key, size_t key_len);
+    size_t (*size)(struct ConcurrentHashTable *self);
+    void (*pin)(struct ConcurrentHashTable *self);
+    void (*unpin)(struct ConcurrentHashTable *self);
+    void (*free)(struct ConcurrentHashTable *self);
+} ConcurrentHashTable;
+
+
+static inline cht_shard* cht_shard_for(ConcurrentHashTable *self, uint64_t hash) {
+    return &self->shards[hash >> (64 - CONCURRENT_HASH_TABLE_SHARD_BITS)];
+}
+
+
+ConcurrentHashTable* New_ConcurrentHashTable();
+static inline void* concurrent_hash_table_get(ConcurrentHashTable *self, char *key);
+static inline void concurrent_hash_table_set(ConcurrentHashTable *self, char *key, void *data, size_t type_size);
+static inline void concurrent_hash_table_delete(ConcurrentHashTable *self, char *key);
+static inline void* concurrent_hash_table_get_bytes(ConcurrentHashTable *self, const void *key, size_t key_len, const uint64_t *hash);
+static inline void concurrent_hash_table_set_bytes(ConcurrentHashTable *self, const void *key, size_t key_len, const uint64_t *hash, void *data, size_t type_size);
+static inline void concurrent_hash_table_delete_bytes(ConcurrentHashTable *self, const void *key, size_t key_len, const uint64_t *hash);
+static inline uint64_t concurrent_hash_table_hash(ConcurrentHashTable *self, const void *key, size_t key_len);
+static size_t concurrent_hash_table_size(ConcurrentHashTable *self);
+static inline void concurrent_hash_table_pin(ConcurrentHashTable *self);
+static inline void concurrent_hash_table_unpin(ConcurrentHashTable *self);
+static void concurrent_hash_table_free(ConcurrentHashTable *self);
+
+
+ConcurrentHashTable* New_ConcurrentHashTable() {
+    ConcurrentHashTable *self = (ConcurrentHashTable*) malloc(sizeof(ConcurrentHashTable));
+
+    if (!self)
+        throw_memory_allocation_error();
+
+    self->self = self;
+
+    if (posix_memalign((void**) &self->shards, CONCURRENT_HASH_TABLE_CACHE_LINE, CONCURRENT_HASH_TABLE_SHARDS * sizeof(cht_shard)) != 0)
+        throw_memory_allocation_error();
+
+    self->seed = hash_random_seed();
+
+    for (size_t i=0; i<CONCURRENT_HASH_TABLE_SHARDS; ++i) {
+        pthread_mutex_init(&self->shards[i].mutex, NULL);
+        ht_engine_init(&self->shards[i].engine);
+        self->shards[i].engine.seed = self->seed;
+    }
+
+    self->get = concurrent_hash_table_get;
+    self->set = concurrent_hash_table_set;
+    self->delete_entry = concurrent_hash_table_delete;
+    self->get_bytes = concurrent_hash_table_get_bytes;
+    self->set_bytes = concurrent_hash_table_set_bytes;
+    self->delete_bytes = concurrent_hash_table_delete_bytes;
+    self->hash = concurrent_hash_table_hash;
+    self->size = concurrent_hash_table_size;
+    self->pin = concurrent_hash_table_pin;
+    self->unpin = concurrent_hash_table_unpin;
+    self->free = concurrent_hash_table_free;
+
+    return self;
+}
+
+
+static inline void* concurrent_hash_table_get(ConcurrentHashTable *self, char *key) {
+    return concurrent_hash_table_get_bytes(self, key, strlen(key), NULL);
+}
+
+
+static inline void concurrent_hash_table_set(ConcurrentHashTable *self, char *key, void *data, size_t type_size) {
+    concurrent_hash_table_set_bytes(self, key, strlen(key), NULL, data, type_size);
+}
+
+
+static inline void concurrent_hash_table_delete(ConcurrentHashTable *self, char *key) {
+    concurrent_hash_table_delete_bytes(self, key, strlen(key), NULL);
+}
+
+
+static inline void* concurrent_hash_table_get_bytes(ConcurrentHashTable *self, const void *key, size_t key_len, const uint64_t *hash) {
+    uint64_t h = hash ? *hash : hash_bytes(key, key_len, self->seed);
+    cht_shard *shard = cht_shard_for(self, h);
+
+    epoch_enter();
+
+    Entry *entry = ht_engine_find(&shard->engine, key, key_len, h);
+    void *res = entry ? __atomic_load_n(&entry->data, __ATOMIC_ACQUIRE) : NULL;
+
+    epoch_exit();
+
+    return res;
+}
+
+
+static inline void concurrent_hash_table_set_bytes(ConcurrentHashTable *self, const void *key, size_t key_len, const uint64_t *hash, void *data, size_t type_size) {
+    uint64_t h = hash ? *hash : hash_bytes(key, key_len, self->seed);
+    cht_shard *shard = cht_shard_for(self, h);
+
+    LOCK(shard->mutex);
+
+    ht_engine_insert(&shard->engine, key, key_len, h, data, type_size, false, false);
+
+    UNLOCK(shard->mutex);
+}
+
+
+static inline void concurrent_hash_table_delete_bytes(ConcurrentHashTable *self, const void *key, size_t key_len, const uint64_t *hash) {
+    uint64_t h = hash ? *hash : hash_bytes(key, key_len, self->seed);
+    cht_shard *shard = cht_shard_for(self, h);
+
+    LOCK(shard->mutex);
+
+    ht_engine_erase(&shard->engine, key, key_len, h, NULL);
+
+    UNLOCK(shard->mutex);
+}
+
+
+static inline uint64_t concurrent_hash_table_hash(ConcurrentHashTable *self, const void *key, size_t key_len) {
+    return hash_bytes(key, key_len, self->seed);
+}
+
+
+static size_t concurrent_hash_table_size(ConcurrentHashTable *self) {
+    size_t size = 0;
+
+    for (size_t i=0; i<CONCURRENT_HASH_TABLE_SHARDS; ++i) {
+        LOCK(self->shards[i].mutex);
+        size += self->shards[i].engine.size;
+        UNLOCK(self->shards[i].mutex);
+    }
+
+    return size;
+}
+
+
+static inline void concurrent_hash_table_pin(ConcurrentHashTable *self) {
+    (void) self;
+    epoch_enter();
+}
+
+
+static inline void concurrent_hash_table_unpin(ConcurrentHashTable *self) {
+    (void) self;
+    epoch_exit();
+}
+
+
+static void concurrent_hash_table_free(ConcurrentHashTable *self) {
+    for (size_t i=0; i<CONCURRENT_HASH_TABLE_SHARDS; ++i) {
+        ht_engine_destroy(&self->shards[i].engine);
+        pthread_mutex_destroy(&self->shards[i].mutex);
+    }
+
+    free(self->shards);
+    free(self);
+}
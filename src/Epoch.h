@@ -0,0 +1,224 @@
+#pragma once
+
+
+#include "./internals.h"
+
+
+#define EPOCH_COLLECT_THRESHOLD 128
+#define EPOCH_CACHE_LINE 64
+
+
+typedef struct epoch_record {
+    uint64_t epoch;
+    size_t depth;
+    bool in_use;
+
+    struct epoch_record *next;
+} __attribute__((aligned(EPOCH_CACHE_LINE))) epoch_record;
+
+
+typedef struct epoch_retired {
+    uint64_t epoch;
+    void (*reclaim)(void *ctx, void *ptr);
+    void *ctx;
+    void *ptr;
+} epoch_retired;
+
+
+typedef struct epoch_bag {
+    epoch_retired *items;
+    size_t len;
+    size_t capacity;
+} epoch_bag;
+
+
+uint64_t epoch_global = 1;
+epoch_record *epoch_records = NULL;
+pthread_mutex_t epoch_records_mutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_key_t epoch_key;
+pthread_once_t epoch_key_once = PTHREAD_ONCE_INIT;
+__thread epoch_record *epoch_local = NULL;
+
+
+static void epoch_release_record(void *record);
+static void epoch_init_key();
+static epoch_record* epoch_acquire_record();
+static inline void epoch_enter();
+static inline void epoch_exit();
+static inline void epoch_free(void *ctx, void *ptr);
+static inline void epoch_bag_init(epoch_bag *bag);
+static inline void epoch_bag_push(epoch_bag *bag, uint64_t epoch, void (*reclaim)(void *ctx, void *ptr), void *ctx, void *ptr);
+static void epoch_bag_reclaim(epoch_bag *bag, uint64_t safe);
+static void epoch_collect(epoch_bag *bag);
+static inline void epoch_retire(epoch_bag *bag, void (*reclaim)(void *ctx, void *ptr), void *ctx, void *ptr);
+static void epoch_drain(epoch_bag *bag);
+static void epoch_synchronize();
+
+
+static void epoch_release_record(void *record) {
+    epoch_record *self = (epoch_record*) record;
+
+    __atomic_store_n(&self->epoch, 0, __ATOMIC_RELEASE);
+    self->depth = 0;
+    __atomic_store_n(&self->in_use, false, __ATOMIC_RELEASE);
+}
+
+
+static void epoch_init_key() {
+    pthread_key_create(&epoch_key, epoch_release_record);
+}
+
+
+static epoch_record* epoch_acquire_record() {
+    pthread_once(&epoch_key_once, epoch_init_key);
+
+    LOCK(epoch_records_mutex);
+
+    epoch_record *record = epoch_records;
+
+    while (record && __atomic_load_n(&record->in_use, __ATOMIC_ACQUIRE))
+        record = record->next;
+
+    if (!record) {
+        if (posix_memalign((void**) &record, EPOCH_CACHE_LINE, sizeof(epoch_record)) != 0)
+            throw_memory_allocation_error();
+
+        record->epoch = 0;
+        record->next = epoch_records;
+        __atomic_store_n(&epoch_records, record, __ATOMIC_RELEASE);
+    }
+
+    record->depth = 0;
+    __atomic_store_n(&record->in_use, true, __ATOMIC_RELEASE);
+
+    UNLOCK(epoch_records_mutex);
+
+    pthread_setspecific(epoch_key, record);
+
+    return record;
+}
+
+
+static inline void epoch_enter() {
+    epoch_record *record = epoch_local;
+
+    if (!record)
+        record = epoch_local = epoch_acquire_record();
+
+    if (record->depth++ == 0) {
+        __atomic_store_n(&record->epoch, __atomic_load_n(&epoch_global, __ATOMIC_ACQUIRE), __ATOMIC_SEQ_CST);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    }
+}
+
+
+static inline void epoch_exit() {
+    epoch_record *record = epoch_local;
+
+    if (--record->depth == 0)
+        __atomic_store_n(&record->epoch, 0, __ATOMIC_RELEASE);
+}
+
+
+static inline void epoch_free(void *ctx, void *ptr) {
+    (void) ctx;
+    free(ptr);
+}
+
+
+static inline void epoch_bag_init(epoch_bag *bag) {
+    bag->len = 0;
+    bag->capacity = EPOCH_COLLECT_THRESHOLD;
+    bag->items = (epoch_retired*) malloc(bag->capacity * sizeof(epoch_retired));
+
+    if (!bag->items)
+        throw_memory_allocation_error();
+}
+
+
+static inline void epoch_bag_push(epoch_bag *bag, uint64_t epoch, void (*reclaim)(void *ctx, void *ptr), void *ctx, void *ptr) {
+    if (bag->len == bag->capacity) {
+        size_t new_capacity = bag->capacity * 2;
+        epoch_retired *new_items = (epoch_retired*) realloc(bag->items, new_capacity * sizeof(epoch_retired));
+
+        if (!new_items)
+            throw_memory_allocation_error();
+
+        bag->items = new_items;
+        bag->capacity = new_capacity;
+    }
+
+    epoch_retired *item = &bag->items[bag->len++];
+    item->epoch = epoch;
+    item->reclaim = reclaim;
+    item->ctx = ctx;
+    item->ptr = ptr;
+}
+
+
+static void epoch_bag_reclaim(epoch_bag *bag, uint64_t safe) {
+    size_t reclaimed = 0;
+
+    while (reclaimed < bag->len && bag->items[reclaimed].epoch < safe) {
+        epoch_retired *item = &bag->items[reclaimed++];
+        item->reclaim(item->ctx, item->ptr);
+    }
+
+    if (reclaimed == 0)
+        return;
+
+    memmove(bag->items, bag->items + reclaimed, (bag->len - reclaimed) * sizeof(epoch_retired));
+    bag->len -= reclaimed;
+}
+
+
+static void epoch_collect(epoch_bag *bag) {
+    __atomic_fetch_add(&epoch_global, 1, __ATOMIC_SEQ_CST);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    uint64_t safe = __atomic_load_n(&epoch_global, __ATOMIC_SEQ_CST);
+
+    for (epoch_record *r = __atomic_load_n(&epoch_records, __ATOMIC_ACQUIRE); r; r = r->next) {
+        uint64_t epoch = __atomic_load_n(&r->epoch, __ATOMIC_SEQ_CST);
+
+        if (epoch && epoch < safe)
+            safe = epoch;
+    }
+
+    epoch_bag_reclaim(bag, safe);
+}
+
+
+static inline void epoch_retire(epoch_bag *bag, void (*reclaim)(void *ctx, void *ptr), void *ctx, void *ptr) {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    epoch_bag_push(bag, __atomic_load_n(&epoch_global, __ATOMIC_SEQ_CST), reclaim, ctx, ptr);
+
+    if (bag->len >= EPOCH_COLLECT_THRESHOLD && bag->len % EPOCH_COLLECT_THRESHOLD == 0)
+        epoch_collect(bag);
+}
+
+
+static void epoch_drain(epoch_bag *bag) {
+    for (size_t i=0; i<bag->len; ++i)
+        bag->items[i].reclaim(bag->items[i].ctx, bag->items[i].ptr);
+
+    free(bag->items);
+
+    bag->items = NULL;
+    bag->len = bag->capacity = 0;
+}
+
+
+static void epoch_synchronize() {
+    uint64_t target = __atomic_add_fetch(&epoch_global, 1, __ATOMIC_SEQ_CST);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    for (epoch_record *r = __atomic_load_n(&epoch_records, __ATOMIC_ACQUIRE); r; r = r->next) {
+        if (r == epoch_local)
+            continue;
+
+        for (uint64_t epoch = __atomic_load_n(&r->epoch, __ATOMIC_SEQ_CST); epoch && epoch < target; epoch = __atomic_load_n(&r->epoch, __ATOMIC_SEQ_CST))
+            sched_yield();
+    }
+}
@@ -0,0 +1,181 @@
+#pragma once
+
+
+#include "./internals.h"
+
+
+#define HASH_FNV1A 0
+#define HASH_MURMUR64A 1
+#define HASH_WYHASH 2
+
+#ifndef HASH_FUNCTION
+#define HASH_FUNCTION HASH_WYHASH
+#endif
+
+
+#define FNV_OFFSET_64 14695981039346656037ULL
+#define FNV_PRIME_64  1099511628211ULL
+
+#define MURMUR64A_M 0xc6a4a7935bd1e995ULL
+#define MURMUR64A_R 47
+
+#define WYHASH_S0 0xa0761d6478bd642fULL
+#define WYHASH_S1 0xe7037ed1a0b428dbULL
+#define WYHASH_S2 0x8ebc6af09c88c6e3ULL
+#define WYHASH_S3 0x589965cc75374cc3ULL
+
+
+static inline uint64_t fnv1a_64(const void *key, size_t len) {
+    const uint8_t *data = (const uint8_t*) key;
+    uint64_t hash = FNV_OFFSET_64;
+
+    for (size_t i=0; i<len; ++i) {
+        hash ^= data[i];
+        hash *= FNV_PRIME_64;
+    }
+
+    return hash;
+}
+
+
+static inline uint64_t hash_read64(const uint8_t *p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+
+static inline uint64_t hash_read32(const uint8_t *p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+
+static inline uint64_t hash_fnv1a(const void *key, size_t len, uint64_t seed) {
+    const uint8_t *data = (const uint8_t*) key;
+    uint64_t hash = FNV_OFFSET_64 ^ seed;
+
+    for (size_t i=0; i<len; ++i) {
+        hash ^= data[i];
+        hash *= FNV_PRIME_64;
+    }
+
+    return hash;
+}
+
+
+static inline uint64_t hash_murmur64a(const void *key, size_t len, uint64_t seed) {
+    const uint8_t *data = (const uint8_t*) key;
+    const uint8_t *end = data + (len & ~(size_t) 7);
+    uint64_t hash = seed ^ (len * MURMUR64A_M);
+
+    for (; data != end; data += 8) {
+        uint64_t k = hash_read64(data);
+
+        k *= MURMUR64A_M;
+        k ^= k >> MURMUR64A_R;
+        k *= MURMUR64A_M;
+
+        hash ^= k;
+        hash *= MURMUR64A_M;
+    }
+
+    if (len & 7) {
+        uint64_t tail = 0;
+        memcpy(&tail, data, len & 7);
+
+        hash ^= tail;
+        hash *= MURMUR64A_M;
+    }
+
+    hash ^= hash >> MURMUR64A_R;
+    hash *= MURMUR64A_M;
+    hash ^= hash >> MURMUR64A_R;
+
+    return hash;
+}
+
+
+static inline uint64_t hash_wymix(uint64_t a, uint64_t b) {
+    __uint128_t r = (__uint128_t) a * b;
+    return (uint64_t) r ^ (uint64_t) (r >> 64);
+}
+
+
+static inline uint64_t hash_wyhash(const void *key, size_t len, uint64_t seed) {
+    const uint8_t *p = (const uint8_t*) key;
+    uint64_t a, b;
+
+    seed ^= hash_wymix(seed ^ WYHASH_S0, WYHASH_S1);
+
+    if (len <= 16) {
+        if (len >= 4) {
+            a = (hash_read32(p) << 32) | hash_read32(p + ((len >> 3) << 2));
+            b = (hash_read32(p + len - 4) << 32) | hash_read32(p + len - 4 - ((len >> 3) << 2));
+        } else if (len > 0) {
+            a = ((uint64_t) p[0] << 16) | ((uint64_t) p[len >> 1] << 8) | p[len - 1];
+            b = 0;
+        } else {
+            a = b = 0;
+        }
+    } else {
+        size_t i = len;
+
+        if (i > 48) {
+            uint64_t see1 = seed;
+            uint64_t see2 = seed;
+
+            do {
+                seed = hash_wymix(hash_read64(p) ^ WYHASH_S1, hash_read64(p + 8) ^ seed);
+                see1 = hash_wymix(hash_read64(p + 16) ^ WYHASH_S2, hash_read64(p + 24) ^ see1);
+                see2 = hash_wymix(hash_read64(p + 32) ^ WYHASH_S3, hash_read64(p + 40) ^ see2);
+                p += 48;
+                i -= 48;
+            } while (i > 48);
+
+            seed ^= see1 ^ see2;
+        }
+
+        while (i > 16) {
+            seed = hash_wymix(hash_read64(p) ^ WYHASH_S1, hash_read64(p + 8) ^ seed);
+            p += 16;
+            i -= 16;
+        }
+
+        a = hash_read64(p + i - 16);
+        b = hash_read64(p + i - 8);
+    }
+
+    __uint128_t r = (__uint128_t) (a ^ WYHASH_S1) * (b ^ seed);
+
+    return hash_wymix((uint64_t) r ^ WYHASH_S0 ^ len, (uint64_t) (r >> 64) ^ WYHASH_S1);
+}
+
+
+static inline uint64_t hash_bytes(const void *key, size_t len, uint64_t seed) {
+#if HASH_FUNCTION == HASH_FNV1A
+    return hash_fnv1a(key, len, seed);
+#elif HASH_FUNCTION == HASH_MURMUR64A
+    return hash_murmur64a(key, len, seed);
+#else
+    return hash_wyhash(key, len, seed);
+#endif
+}
+
+
+static inline uint64_t hash_random_seed() {
+#ifdef HASH_FIXED_SEED
+    return HASH_FIXED_SEED;
+#else
+    uint64_t seed;
+
+    if (getrandom(&seed, sizeof(seed), GRND_NONBLOCK) == (ssize_t) sizeof(seed))
+        return seed;
+
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return hash_wyhash(&ts, sizeof(ts), (uint64_t) (uintptr_t) &ts);
+#endif
+}
@@ -2,58 +2,306 @@
 
 
 #include "./internals.h"
-#include "./ArrayList.h"
+#include "./Epoch.h"
+#include "./Hash.h"
 
 
-#define HASH_TABLE_CAPACITY 128
+#define HASH_TABLE_INITIAL_CAPACITY 16
+#define HASH_TABLE_GROUP_WIDTH 8
+#define HASH_TABLE_MIGRATION_GROUPS 8
+#define HASH_TABLE_BATCH 16
+#define HASH_TABLE_NOT_FOUND SIZE_MAX
 
+#define HASH_TABLE_SEGMENT_BASE_BITS 4
+#define HASH_TABLE_SEGMENT_BASE (1 << HASH_TABLE_SEGMENT_BASE_BITS)
+#define HASH_TABLE_SEGMENTS 48
 
-#define FNV_OFFSET_64 14695981039346656037ULL
-#define FNV_PRIME_64  1099511628211ULL
+#define HASH_TABLE_INLINE_KEY 21
+#define HASH_TABLE_INLINE_DATA 16
 
+#define HASH_TABLE_SNAPSHOT_MAGIC "SLHTSNAP"
+#define HASH_TABLE_SNAPSHOT_VERSION 1
+#define HASH_TABLE_SNAPSHOT_ALIGN 16
 
-static inline uint64_t fnv1a_64(const void *key, size_t len) {
-    const uint8_t *data = (const uint8_t*) key;
-    uint64_t hash = FNV_OFFSET_64;
+#define HASH_TABLE_CTRL_EMPTY ((int8_t) -128)
+#define HASH_TABLE_CTRL_DELETED ((int8_t) -2)
 
-    for (size_t i=0; i<len; ++i) {
-        hash ^= data[i];
-        hash *= FNV_PRIME_64;
-    }
-
-    return hash;
-}
+#define HASH_TABLE_LSBS 0x0101010101010101ULL
+#define HASH_TABLE_MSBS 0x8080808080808080ULL
 
 
-static inline size_t hash_index(const char *key) {
-    return fnv1a_64(key, strlen(key)) % HASH_TABLE_CAPACITY;
-}
+typedef uint64_t __attribute__((may_alias)) ht_group;
 
 
 typedef struct entry {
+    char inline_data[HASH_TABLE_INLINE_DATA] __attribute__((aligned(16)));
+    uint64_t hash;
     char *key;
     void *data;
+    size_t key_len;
+    size_t data_len;
+    char inline_key[HASH_TABLE_INLINE_KEY];
+    bool live;
+    bool adopted;
+    bool key_borrowed;
 } Entry;
 
 
+typedef struct ht_slot {
+    uint64_t hash;
+    size_t entry;
+} ht_slot;
+
+
+typedef struct ht_index {
+    int8_t *ctrl;
+    ht_slot *slots;
+    size_t capacity;
+    size_t growth_left;
+
+    struct ht_index *old;
+} ht_index;
+
+
+typedef struct ht_snapshot_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t hash_function;
+    uint64_t seed;
+    uint64_t capacity;
+    uint64_t size;
+    uint64_t ctrl_offset;
+    uint64_t slots_offset;
+    uint64_t file_size;
+} ht_snapshot_header;
+
+
+typedef struct ht_snapshot_record {
+    uint64_t key_len;
+    uint64_t data_len;
+} ht_snapshot_record;
+
+
+typedef struct ht_save_item {
+    const char *key;
+    const void *data;
+    size_t key_len;
+    size_t data_len;
+} ht_save_item;
+
+
+typedef struct ht_save_plan {
+    ht_snapshot_header header;
+    ht_index *index;
+    ht_save_item *items;
+    size_t len;
+} ht_save_plan;
+
+
+typedef struct HashTableCursor {
+    size_t position;
+
+    size_t *pending;
+    size_t pending_len;
+    size_t pending_capacity;
+
+    struct HashTableCursor *next;
+    struct HashTableCursor *prev;
+} HashTableCursor;
+
+
+typedef void (*ht_visit_func)(const char *key, size_t key_len, void *data, va_list args);
+
+
+typedef struct ht_engine {
+    ht_index *index;
+    size_t migrate_pos;
+    size_t size;
+
+    Entry *segments[HASH_TABLE_SEGMENTS];
+    size_t entries_len;
+
+    size_t *holes;
+    size_t holes_len;
+    size_t holes_capacity;
+
+    uint64_t seed;
+    epoch_bag bag;
+
+    HashTableCursor *cursors;
+
+    void (*destructor)(void *data);
+} ht_engine;
+
+
 typedef struct HashTable {
     struct HashTable *self;
 
-    ArrayList *table;
+    ht_engine engine;
     pthread_mutex_t mutex;
     pthread_mutexattr_t mutex_attr;
 
     void* (*get)(struct HashTable *self, char *key);
     void (*set)(struct HashTable *self, char *key, void *data, size_t type_size);
     void (*delete_entry)(struct HashTable *self, char *key);
+    void* (*get_bytes)(struct HashTable *self, const void *key, size_t key_len, const uint64_t *hash);
+    void (*set_bytes)(struct HashTable *self, const void *key, size_t key_len, const uint64_t *hash, void *data, size_t type_size);
+    void (*delete_bytes)(struct HashTable *self, const void *key, size_t key_len, const uint64_t *hash);
+    void (*adopt)(struct HashTable *self, char *key, void *data, size_t type_size);
+    void (*adopt_bytes)(struct HashTable *self, const void *key, size_t key_len, const uint64_t *hash, void *data, size_t type_size);
+    void* (*steal)(struct HashTable *self, char *key);
+    void* (*steal_bytes)(struct HashTable *self, const void *key, size_t key_len, const uint64_t *hash);
+    void (*get_many)(struct HashTable *self, char **keys, size_t count, void **results);
+    void (*set_many)(struct HashTable *self, char **keys, size_t count, void **data, size_t type_size);
+    void (*get_many_bytes)(struct HashTable *self, const void **keys, const size_t *key_lens, const uint64_t *hashes, size_t count, void **results);
+    void (*set_many_bytes)(struct HashTable *self, const void **keys, const size_t *key_lens, const uint64_t *hashes, size_t count, void **data, size_t type_size);
+    uint64_t (*hash)(struct HashTable *self, const void *key, size_t key_len);
+    double (*rehash_progress)(struct HashTable *self);
+    void (*pin)(struct HashTable *self);
+    void (*unpin)(struct HashTable *self);
+    void (*set_destructor)(struct HashTable *self, void (*destructor)(void *data));
+    void (*foreach)(struct HashTable *self, ht_visit_func func, ...);
+    HashTableCursor* (*cursor_open)(struct HashTable *self);
+    bool (*scan)(struct HashTable *self, HashTableCursor *cursor, size_t count, ht_visit_func func, ...);
+    void (*cursor_close)(struct HashTable *self, HashTableCursor *cursor);
+    bool (*save)(struct HashTable *self, const char *path);
     void (*free)(struct HashTable *self);
 } HashTable;
 
 
+static inline size_t ht_h1(uint64_t hash) {
+    return (size_t) (hash >> 7);
+}
+
+
+static inline int8_t ht_h2(uint64_t hash) {
+    return (int8_t) (hash & 0x7F);
+}
+
+
+static inline size_t ht_capacity_to_growth(size_t capacity) {
+    return capacity - capacity / 8;
+}
+
+
+static inline int8_t ht_ctrl_get(const ht_index *index, size_t pos) {
+    return index->ctrl[pos] ^ HASH_TABLE_CTRL_EMPTY;
+}
+
+
+static inline void ht_ctrl_set(ht_index *index, size_t pos, int8_t ctrl) {
+    __atomic_store_n(&index->ctrl[pos], (int8_t) (ctrl ^ HASH_TABLE_CTRL_EMPTY), __ATOMIC_RELEASE);
+}
+
+
+static inline uint64_t ht_group_load(const int8_t *ctrl) {
+    uint64_t group = __atomic_load_n((const ht_group*) ctrl, __ATOMIC_ACQUIRE);
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    group = __builtin_bswap64(group);
+#endif
+
+    return group ^ HASH_TABLE_MSBS;
+}
+
+
+static inline uint64_t ht_group_match(uint64_t group, int8_t h2) {
+    uint64_t x = group ^ (HASH_TABLE_LSBS * (uint8_t) h2);
+    return (x - HASH_TABLE_LSBS) & ~x & HASH_TABLE_MSBS;
+}
+
+
+static inline uint64_t ht_group_match_empty(uint64_t group) {
+    return group & ~(group << 6) & HASH_TABLE_MSBS;
+}
+
+
+static inline uint64_t ht_group_match_empty_or_deleted(uint64_t group) {
+    return group & ~(group << 7) & HASH_TABLE_MSBS;
+}
+
+
+static inline size_t ht_mask_next(uint64_t *mask) {
+    size_t i = __builtin_ctzll(*mask) >> 3;
+    *mask &= *mask - 1;
+    return i;
+}
+
+
+static inline uint64_t ht_engine_hash(const ht_engine *engine, const void *key, size_t key_len) {
+    return hash_bytes(key, key_len, engine->seed);
+}
+
+
+static inline Entry* ht_engine_entry(const ht_engine *engine, size_t index) {
+    size_t biased = index + HASH_TABLE_SEGMENT_BASE;
+    size_t segment = 63 - __builtin_clzll(biased) - HASH_TABLE_SEGMENT_BASE_BITS;
+    Entry *base = __atomic_load_n(&engine->segments[segment], __ATOMIC_ACQUIRE);
+
+    return &base[biased - ((size_t) HASH_TABLE_SEGMENT_BASE << segment)];
+}
+
+
 HashTable* New_HashTable();
+static ht_index* ht_index_new(size_t capacity);
+static void ht_index_reclaim(void *ctx, void *ptr);
+static inline size_t ht_index_find(const ht_index *index, const ht_engine *engine, const void *key, size_t key_len, uint64_t hash, Entry **entry);
+static inline size_t ht_index_find_first_non_full(const ht_index *index, uint64_t hash);
+static inline void ht_index_set(ht_index *index, size_t pos, uint64_t hash, size_t entry);
+static inline void ht_index_erase(ht_index *index, size_t pos);
+static void ht_engine_init(ht_engine *engine);
+static void ht_engine_start_resize(ht_engine *engine);
+static void ht_engine_migrate(ht_engine *engine, size_t groups);
+static size_t ht_engine_alloc_entry(ht_engine *engine);
+static void ht_engine_reclaim_entry(void *ctx, void *ptr);
+static inline Entry* ht_engine_find(ht_engine *engine, const void *key, size_t key_len, uint64_t hash);
+static void ht_engine_find_batch(ht_engine *engine, const void **keys, const size_t *key_lens, const uint64_t *hashes, size_t count, Entry **entries);
+static inline void ht_engine_prefetch(const ht_engine *engine, uint64_t hash);
+static inline size_t ht_engine_locate(ht_engine *engine, const void *key, size_t key_len, uint64_t hash, ht_index **index, Entry **entry);
+static inline char* ht_entry_store_key(Entry *entry, const void *key, size_t key_len);
+static inline void* ht_entry_store_data(Entry *entry, const void *data, size_t type_size, bool adopted);
+static void ht_engine_destroy_data(void *ctx, void *ptr);
+static inline void ht_engine_retire_data(ht_engine *engine, const Entry *entry, void *data, bool adopted);
+static void ht_engine_replace(ht_engine *engine, ht_index *index, size_t pos, Entry *entry, const void *key, const void *data, size_t type_size, bool adopted, bool borrow_key);
+static bool ht_engine_insert(ht_engine *engine, const void *key, size_t key_len, uint64_t hash, const void *data, size_t type_size, bool adopted, bool borrow_key);
+static bool ht_engine_erase(ht_engine *engine, const void *key, size_t key_len, uint64_t hash, void **stolen);
+static inline double ht_engine_rehash_progress(const ht_engine *engine);
+static void ht_engine_destroy(ht_engine *engine);
+static inline size_t ht_snapshot_align(size_t n);
+static inline size_t ht_snapshot_record_size(size_t key_len, size_t data_len);
+static inline bool ht_snapshot_write(FILE *file, const void *data, size_t len);
+static ht_save_plan* ht_engine_plan_save(const ht_engine *engine);
+static bool ht_save_plan_write(const ht_save_plan *plan, const char *path);
+static void ht_save_plan_free(ht_save_plan *plan);
+static HashTableCursor* ht_engine_cursor_open(ht_engine *engine);
+static void ht_engine_cursor_close(ht_engine *engine, HashTableCursor *cursor);
+static void ht_cursor_push(HashTableCursor *cursor, size_t entry);
+static void ht_engine_note_move(ht_engine *engine, size_t from, size_t to);
+static bool ht_engine_scan(ht_engine *engine, HashTableCursor *cursor, size_t count, ht_visit_func func, va_list args);
 static inline void* hash_table_get(HashTable *self, char *key);
 static inline void hash_table_set(HashTable *self, char *key, void *data, size_t type_size);
 static inline void hash_table_delete(HashTable *self, char *key);
+static inline void* hash_table_get_bytes(HashTable *self, const void *key, size_t key_len, const uint64_t *hash);
+static inline void hash_table_set_bytes(HashTable *self, const void *key, size_t key_len, const uint64_t *hash, void *data, size_t type_size);
+static inline void hash_table_delete_bytes(HashTable *self, const void *key, size_t key_len, const uint64_t *hash);
+static inline void hash_table_adopt(HashTable *self, char *key, void *data, size_t type_size);
+static inline void hash_table_adopt_bytes(HashTable *self, const void *key, size_t key_len, const uint64_t *hash, void *data, size_t type_size);
+static inline void* hash_table_steal(HashTable *self, char *key);
+static inline void* hash_table_steal_bytes(HashTable *self, const void *key, size_t key_len, const uint64_t *hash);
+static void hash_table_get_many(HashTable *self, char **keys, size_t count, void **results);
+static void hash_table_set_many(HashTable *self, char **keys, size_t count, void **data, size_t type_size);
+static void hash_table_get_many_bytes(HashTable *self, const void **keys, const size_t *key_lens, const uint64_t *hashes, size_t count, void **results);
+static void hash_table_set_many_bytes(HashTable *self, const void **keys, const size_t *key_lens, const uint64_t *hashes, size_t count, void **data, size_t type_size);
+static inline uint64_t hash_table_hash(HashTable *self, const void *key, size_t key_len);
+static inline double hash_table_rehash_progress(HashTable *self);
+static inline void hash_table_pin(HashTable *self);
+static inline void hash_table_unpin(HashTable *self);
+static void hash_table_set_destructor(HashTable *self, void (*destructor)(void *data));
+static void hash_table_foreach(HashTable *self, ht_visit_func func, ...);
+static HashTableCursor* hash_table_cursor_open(HashTable *self);
+static bool hash_table_scan(HashTable *self, HashTableCursor *cursor, size_t count, ht_visit_func func, ...);
+static void hash_table_cursor_close(HashTable *self, HashTableCursor *cursor);
+static bool hash_table_save(HashTable *self, const char *path);
 static void hash_table_free(HashTable *self);
 
 
@@ -63,7 +311,9 @@ HashTable* New_HashTable() {
     if (!self)
         throw_memory_allocation_error();
 
-    self->table = New_ArrayList();
+    self->self = self;
+
+    ht_engine_init(&self->engine);
 
     pthread_mutexattr_init(&self->mutex_attr);
     pthread_mutexattr_settype(&self->mutex_attr, PTHREAD_MUTEX_RECURSIVE);
@@ -73,131 +323,1037 @@ HashTable* New_HashTable() {
     self->set = hash_table_set;
     self->get = hash_table_get;
     self->delete_entry = hash_table_delete;
+    self->get_bytes = hash_table_get_bytes;
+    self->set_bytes = hash_table_set_bytes;
+    self->delete_bytes = hash_table_delete_bytes;
+    self->adopt = hash_table_adopt;
+    self->adopt_bytes = hash_table_adopt_bytes;
+    self->steal = hash_table_steal;
+    self->steal_bytes = hash_table_steal_bytes;
+    self->get_many = hash_table_get_many;
+    self->set_many = hash_table_set_many;
+    self->get_many_bytes = hash_table_get_many_bytes;
+    self->set_many_bytes = hash_table_set_many_bytes;
+    self->hash = hash_table_hash;
+    self->rehash_progress = hash_table_rehash_progress;
+    self->pin = hash_table_pin;
+    self->unpin = hash_table_unpin;
+    self->set_destructor = hash_table_set_destructor;
+    self->foreach = hash_table_foreach;
+    self->cursor_open = hash_table_cursor_open;
+    self->scan = hash_table_scan;
+    self->cursor_close = hash_table_cursor_close;
+    self->save = hash_table_save;
     self->free = hash_table_free;
 
     return self;
 }
 
 
-static inline void* hash_table_get(HashTable *self, char *key) {
-    LOCK(self->mutex);
+static ht_index* ht_index_new(size_t capacity) {
+    ht_index *index = (ht_index*) malloc(sizeof(ht_index));
 
-    void *res = NULL;
+    if (!index)
+        throw_memory_allocation_error();
 
-    size_t index = hash_index(key);
-    ArrayList *bucket = self->table->get_at(self->table, index);
+    index->ctrl = (int8_t*) calloc(capacity, sizeof(int8_t));
+    index->slots = (ht_slot*) malloc(capacity * sizeof(ht_slot));
 
-    if (bucket) {
-        for (size_t i=0; i<bucket->capacity; ++i) {
-            Entry *entry = bucket->get_at(bucket, i);
+    if (!index->ctrl || !index->slots)
+        throw_memory_allocation_error();
 
-            if (entry && strcmp(entry->key, key)==0) {
-                res = entry->data;
-                break;
+    index->capacity = capacity;
+    index->growth_left = ht_capacity_to_growth(capacity);
+    index->old = NULL;
+
+    return index;
+}
+
+
+static void ht_index_reclaim(void *ctx, void *ptr) {
+    ht_index *index = (ht_index*) ptr;
+    (void) ctx;
+
+    free(index->ctrl);
+    free(index->slots);
+    free(index);
+}
+
+
+static inline size_t ht_index_find(const ht_index *index, const ht_engine *engine, const void *key, size_t key_len, uint64_t hash, Entry **entry) {
+    size_t groups_mask = index->capacity / HASH_TABLE_GROUP_WIDTH - 1;
+    size_t group = ht_h1(hash) & groups_mask;
+    int8_t h2 = ht_h2(hash);
+
+    for (size_t step=1; ; ++step) {
+        size_t base = group * HASH_TABLE_GROUP_WIDTH;
+        uint64_t ctrl = ht_group_load(index->ctrl + base);
+        uint64_t match = ht_group_match(ctrl, h2);
+
+        while (match) {
+            size_t pos = base + ht_mask_next(&match);
+            const ht_slot *slot = &index->slots[pos];
+
+            if (__atomic_load_n(&slot->hash, __ATOMIC_RELAXED) != hash)
+                continue;
+
+            Entry *candidate = ht_engine_entry(engine, __atomic_load_n(&slot->entry, __ATOMIC_ACQUIRE));
+            char *candidate_key = __atomic_load_n(&candidate->key, __ATOMIC_ACQUIRE);
+
+            if (candidate_key && candidate->key_len == key_len && memcmp(candidate_key, key, key_len) == 0) {
+                *entry = candidate;
+                return pos;
             }
         }
+
+        if (ht_group_match_empty(ctrl))
+            return HASH_TABLE_NOT_FOUND;
+
+        group = (group + step) & groups_mask;
     }
+}
 
-    UNLOCK(self->mutex);
 
-    return res;
+static inline size_t ht_index_find_first_non_full(const ht_index *index, uint64_t hash) {
+    size_t groups_mask = index->capacity / HASH_TABLE_GROUP_WIDTH - 1;
+    size_t group = ht_h1(hash) & groups_mask;
+
+    for (size_t step=1; ; ++step) {
+        size_t base = group * HASH_TABLE_GROUP_WIDTH;
+        uint64_t mask = ht_group_match_empty_or_deleted(ht_group_load(index->ctrl + base));
+
+        if (mask)
+            return base + ht_mask_next(&mask);
+
+        group = (group + step) & groups_mask;
+    }
 }
 
 
-static inline void hash_table_set(HashTable *self, char *key, void *data, size_t type_size) {
-    LOCK(self->mutex);
+static inline void ht_index_set(ht_index *index, size_t pos, uint64_t hash, size_t entry) {
+    if (ht_ctrl_get(index, pos) == HASH_TABLE_CTRL_EMPTY)
+        index->growth_left--;
+
+    __atomic_store_n(&index->slots[pos].hash, hash, __ATOMIC_RELAXED);
+    __atomic_store_n(&index->slots[pos].entry, entry, __ATOMIC_RELEASE);
+    ht_ctrl_set(index, pos, ht_h2(hash));
+}
+
+
+static inline void ht_index_erase(ht_index *index, size_t pos) {
+    size_t base = pos - pos % HASH_TABLE_GROUP_WIDTH;
+
+    if (ht_group_match_empty(ht_group_load(index->ctrl + base))) {
+        ht_ctrl_set(index, pos, HASH_TABLE_CTRL_EMPTY);
+        index->growth_left++;
+    } else {
+        ht_ctrl_set(index, pos, HASH_TABLE_CTRL_DELETED);
+    }
+}
+
+
+static void ht_engine_init(ht_engine *engine) {
+    engine->index = ht_index_new(HASH_TABLE_INITIAL_CAPACITY);
+    engine->migrate_pos = 0;
+    engine->size = 0;
+
+    memset(engine->segments, 0, sizeof(engine->segments));
+    engine->entries_len = 0;
+
+    engine->holes_len = 0;
+    engine->holes_capacity = HASH_TABLE_GROUP_WIDTH;
+    engine->holes = (size_t*) malloc(engine->holes_capacity * sizeof(size_t));
+
+    if (!engine->holes)
+        throw_memory_allocation_error();
+
+    engine->seed = hash_random_seed();
+    epoch_bag_init(&engine->bag);
+    engine->cursors = NULL;
+    engine->destructor = free;
+}
+
+
+static void ht_engine_start_resize(ht_engine *engine) {
+    ht_engine_migrate(engine, SIZE_MAX);
+
+    size_t capacity = engine->index->capacity;
+
+    if (engine->size >= ht_capacity_to_growth(capacity) / 2)
+        capacity *= 2;
+
+    ht_index *index = ht_index_new(capacity);
+    index->old = engine->index;
+    engine->migrate_pos = 0;
+
+    __atomic_store_n(&engine->index, index, __ATOMIC_RELEASE);
+}
+
+
+static void ht_engine_migrate(ht_engine *engine, size_t groups) {
+    ht_index *index = engine->index;
+    ht_index *old = index->old;
+
+    if (!old)
+        return;
+
+    size_t end = old->capacity;
 
-    size_t index = hash_index(key);
-    ArrayList *bucket = self->table->get_at(self->table, index);
+    if (groups < (old->capacity - engine->migrate_pos) / HASH_TABLE_GROUP_WIDTH)
+        end = engine->migrate_pos + groups * HASH_TABLE_GROUP_WIDTH;
 
-    if (!bucket) {
-        bucket = New_ArrayList();
-        self->table->set_at(self->table, bucket, sizeof(ArrayList), index);
+    for (size_t i=engine->migrate_pos; i<end; ++i) {
+        if (ht_ctrl_get(old, i) < 0)
+            continue;
+
+        size_t pos = ht_index_find_first_non_full(index, old->slots[i].hash);
+        ht_index_set(index, pos, old->slots[i].hash, old->slots[i].entry);
+        ht_ctrl_set(old, i, HASH_TABLE_CTRL_DELETED);
+    }
+
+    engine->migrate_pos = end;
+
+    if (end == old->capacity) {
+        __atomic_store_n(&index->old, NULL, __ATOMIC_RELEASE);
+        epoch_retire(&engine->bag, ht_index_reclaim, NULL, old);
+    }
+}
+
+
+static size_t ht_engine_alloc_entry(ht_engine *engine) {
+    if (engine->holes_len > 0)
+        return engine->holes[--engine->holes_len];
+
+    size_t index = engine->entries_len++;
+    size_t biased = index + HASH_TABLE_SEGMENT_BASE;
+    size_t segment = 63 - __builtin_clzll(biased) - HASH_TABLE_SEGMENT_BASE_BITS;
+
+    if (!engine->segments[segment]) {
+        Entry *entries = (Entry*) malloc(((size_t) HASH_TABLE_SEGMENT_BASE << segment) * sizeof(Entry));
+
+        if (!entries)
+            throw_memory_allocation_error();
+
+        __atomic_store_n(&engine->segments[segment], entries, __ATOMIC_RELEASE);
+    }
+
+    return index;
+}
+
+
+static void ht_engine_reclaim_entry(void *ctx, void *ptr) {
+    ht_engine *engine = (ht_engine*) ctx;
+
+    if (engine->holes_len == engine->holes_capacity) {
+        size_t new_capacity = engine->holes_capacity * 2;
+        size_t *new_holes = (size_t*) realloc(engine->holes, new_capacity * sizeof(size_t));
+
+        if (!new_holes)
+            throw_memory_allocation_error();
+
+        engine->holes = new_holes;
+        engine->holes_capacity = new_capacity;
+    }
+
+    engine->holes[engine->holes_len++] = (size_t) (uintptr_t) ptr;
+}
+
+
+static inline Entry* ht_engine_find(ht_engine *engine, const void *key, size_t key_len, uint64_t hash) {
+    ht_index *index = __atomic_load_n(&engine->index, __ATOMIC_ACQUIRE);
+    Entry *entry = NULL;
+
+    for (;;) {
+        ht_index *old = __atomic_load_n(&index->old, __ATOMIC_ACQUIRE);
+
+        if (old && ht_index_find(old, engine, key, key_len, hash, &entry) != HASH_TABLE_NOT_FOUND)
+            return entry;
+
+        if (ht_index_find(index, engine, key, key_len, hash, &entry) != HASH_TABLE_NOT_FOUND)
+            return entry;
+
+        ht_index *current = __atomic_load_n(&engine->index, __ATOMIC_ACQUIRE);
+
+        if (current == index)
+            return NULL;
+
+        index = current;
     }
+}
 
-    for (size_t i=0; i<bucket->capacity; ++i) {
-        Entry *entry = bucket->get_at(bucket, i);
 
-        if (entry && strcmp(entry->key, key) == 0) {
-            free(entry->data);
-            entry->data = copy_from_void_ptr(data, type_size);
-            goto un;
+static void ht_engine_find_batch(ht_engine *engine, const void **keys, const size_t *key_lens, const uint64_t *hashes, size_t count, Entry **entries) {
+    ht_index *index = __atomic_load_n(&engine->index, __ATOMIC_ACQUIRE);
+    size_t groups_mask = index->capacity / HASH_TABLE_GROUP_WIDTH - 1;
+    bool migrating = __atomic_load_n(&index->old, __ATOMIC_ACQUIRE) != NULL;
+    bool resolved[HASH_TABLE_BATCH];
+
+    for (size_t i=0; i<count; ++i) {
+        size_t base = (ht_h1(hashes[i]) & groups_mask) * HASH_TABLE_GROUP_WIDTH;
+
+        __builtin_prefetch(index->ctrl + base);
+        __builtin_prefetch(&index->slots[base]);
+        __builtin_prefetch(&index->slots[base + HASH_TABLE_GROUP_WIDTH / 2]);
+    }
+
+    for (size_t i=0; i<count; ++i) {
+        size_t base = (ht_h1(hashes[i]) & groups_mask) * HASH_TABLE_GROUP_WIDTH;
+        uint64_t ctrl = ht_group_load(index->ctrl + base);
+        uint64_t match = ht_group_match(ctrl, ht_h2(hashes[i]));
+
+        entries[i] = NULL;
+        resolved[i] = !migrating && ht_group_match_empty(ctrl);
+
+        while (match) {
+            const ht_slot *slot = &index->slots[base + ht_mask_next(&match)];
+
+            if (__atomic_load_n(&slot->hash, __ATOMIC_RELAXED) == hashes[i]) {
+                entries[i] = ht_engine_entry(engine, __atomic_load_n(&slot->entry, __ATOMIC_ACQUIRE));
+                __builtin_prefetch(entries[i]);
+                break;
+            }
+        }
+    }
+
+    for (size_t i=0; i<count; ++i) {
+        if (entries[i])
+            __builtin_prefetch(__atomic_load_n(&entries[i]->key, __ATOMIC_ACQUIRE));
+    }
+
+    for (size_t i=0; i<count; ++i) {
+        if (entries[i]) {
+            char *key = __atomic_load_n(&entries[i]->key, __ATOMIC_ACQUIRE);
+
+            if (key && entries[i]->key_len == key_lens[i] && memcmp(key, keys[i], key_lens[i]) == 0)
+                continue;
+        } else if (resolved[i] && __atomic_load_n(&engine->index, __ATOMIC_ACQUIRE) == index) {
+            continue;
         }
+
+        entries[i] = ht_engine_find(engine, keys[i], key_lens[i], hashes[i]);
+    }
+}
+
+
+static inline void ht_engine_prefetch(const ht_engine *engine, uint64_t hash) {
+    const ht_index *index = engine->index;
+    size_t base = (ht_h1(hash) & (index->capacity / HASH_TABLE_GROUP_WIDTH - 1)) * HASH_TABLE_GROUP_WIDTH;
+
+    __builtin_prefetch(index->ctrl + base, 1);
+    __builtin_prefetch(&index->slots[base], 1);
+}
+
+
+static inline size_t ht_engine_locate(ht_engine *engine, const void *key, size_t key_len, uint64_t hash, ht_index **index, Entry **entry) {
+    size_t pos = HASH_TABLE_NOT_FOUND;
+
+    *index = engine->index->old;
+
+    if (*index)
+        pos = ht_index_find(*index, engine, key, key_len, hash, entry);
+
+    if (pos == HASH_TABLE_NOT_FOUND) {
+        *index = engine->index;
+        pos = ht_index_find(*index, engine, key, key_len, hash, entry);
+    }
+
+    return pos;
+}
+
+
+static inline char* ht_entry_store_key(Entry *entry, const void *key, size_t key_len) {
+    char *copy = entry->inline_key;
+
+    if (key_len >= HASH_TABLE_INLINE_KEY) {
+        copy = (char*) malloc(key_len + 1);
+
+        if (!copy)
+            throw_memory_allocation_error();
+    }
+
+    memcpy(copy, key, key_len);
+    copy[key_len] = '\0';
+
+    return copy;
+}
+
+
+static inline void* ht_entry_store_data(Entry *entry, const void *data, size_t type_size, bool adopted) {
+    entry->adopted = adopted;
+    entry->data_len = data ? type_size : 0;
+
+    if (adopted)
+        return (void*) data;
+
+    if (!data || type_size == 0)
+        return NULL;
+
+    if (type_size > HASH_TABLE_INLINE_DATA)
+        return copy_from_void_ptr(data, type_size);
+
+    memcpy(entry->inline_data, data, type_size);
+
+    return entry->inline_data;
+}
+
+
+static void ht_engine_destroy_data(void *ctx, void *ptr) {
+    ht_engine *engine = (ht_engine*) ctx;
+    engine->destructor(ptr);
+}
+
+
+static inline void ht_engine_retire_data(ht_engine *engine, const Entry *entry, void *data, bool adopted) {
+    if (!data || data == entry->inline_data)
+        return;
+
+    if (adopted)
+        epoch_retire(&engine->bag, ht_engine_destroy_data, engine, data);
+    else
+        epoch_retire(&engine->bag, epoch_free, NULL, data);
+}
+
+
+static void ht_engine_replace(ht_engine *engine, ht_index *index, size_t pos, Entry *entry, const void *key, const void *data, size_t type_size, bool adopted, bool borrow_key) {
+    void *old_data = entry->data;
+    bool old_adopted = entry->adopted;
+    bool new_inline = !adopted && data && type_size > 0 && type_size <= HASH_TABLE_INLINE_DATA;
+
+    if (old_data != entry->inline_data && !new_inline && !entry->key_borrowed && !borrow_key) {
+        __atomic_store_n(&entry->data, ht_entry_store_data(entry, data, type_size, adopted), __ATOMIC_RELEASE);
+        ht_engine_retire_data(engine, entry, old_data, old_adopted);
+        return;
+    }
+
+    size_t old_index = index->slots[pos].entry;
+    size_t fresh_index = ht_engine_alloc_entry(engine);
+    Entry *fresh = ht_engine_entry(engine, fresh_index);
+    char *fresh_key = entry->key;
+
+    if (borrow_key) {
+        fresh_key = (char*) key;
+
+        if (entry->key != entry->inline_key && !entry->key_borrowed)
+            epoch_retire(&engine->bag, epoch_free, NULL, entry->key);
+    } else if (entry->key == entry->inline_key || entry->key_borrowed) {
+        fresh_key = ht_entry_store_key(fresh, entry->key, entry->key_len);
+    }
+
+    fresh->key_len = entry->key_len;
+    fresh->key_borrowed = borrow_key;
+    fresh->hash = entry->hash;
+    fresh->live = true;
+    __atomic_store_n(&fresh->data, ht_entry_store_data(fresh, data, type_size, adopted), __ATOMIC_RELAXED);
+    __atomic_store_n(&fresh->key, fresh_key, __ATOMIC_RELEASE);
+
+    __atomic_store_n(&index->slots[pos].entry, fresh_index, __ATOMIC_RELEASE);
+    entry->live = false;
+
+    if (engine->cursors)
+        ht_engine_note_move(engine, old_index, fresh_index);
+
+    ht_engine_retire_data(engine, entry, old_data, old_adopted);
+    epoch_retire(&engine->bag, ht_engine_reclaim_entry, engine, (void*) (uintptr_t) old_index);
+}
+
+
+static bool ht_engine_insert(ht_engine *engine, const void *key, size_t key_len, uint64_t hash, const void *data, size_t type_size, bool adopted, bool borrow_key) {
+    ht_engine_migrate(engine, HASH_TABLE_MIGRATION_GROUPS);
+
+    ht_index *index;
+    Entry *found = NULL;
+    size_t pos = ht_engine_locate(engine, key, key_len, hash, &index, &found);
+
+    if (pos != HASH_TABLE_NOT_FOUND) {
+        ht_engine_replace(engine, index, pos, found, key, data, type_size, adopted, borrow_key);
+        return false;
+    }
+
+    pos = ht_index_find_first_non_full(engine->index, hash);
+
+    if (engine->index->growth_left == 0 && ht_ctrl_get(engine->index, pos) == HASH_TABLE_CTRL_EMPTY) {
+        ht_engine_start_resize(engine);
+        pos = ht_index_find_first_non_full(engine->index, hash);
+    }
+
+    size_t entry_index = ht_engine_alloc_entry(engine);
+    Entry *entry = ht_engine_entry(engine, entry_index);
+    char *key_copy = borrow_key ? (char*) key : ht_entry_store_key(entry, key, key_len);
+
+    entry->key_len = key_len;
+    entry->key_borrowed = borrow_key;
+    entry->hash = hash;
+    entry->live = true;
+    __atomic_store_n(&entry->data, ht_entry_store_data(entry, data, type_size, adopted), __ATOMIC_RELAXED);
+    __atomic_store_n(&entry->key, key_copy, __ATOMIC_RELEASE);
+
+    ht_index_set(engine->index, pos, hash, entry_index);
+    engine->size++;
+
+    return true;
+}
+
+
+static bool ht_engine_erase(ht_engine *engine, const void *key, size_t key_len, uint64_t hash, void **stolen) {
+    ht_engine_migrate(engine, HASH_TABLE_MIGRATION_GROUPS);
+
+    ht_index *index;
+    Entry *entry = NULL;
+    size_t pos = ht_engine_locate(engine, key, key_len, hash, &index, &entry);
+
+    if (pos == HASH_TABLE_NOT_FOUND)
+        return false;
+
+    size_t entry_index = index->slots[pos].entry;
+    char *old_key = entry->key;
+    void *old_data = entry->data;
+
+    ht_index_erase(index, pos);
+    engine->size--;
+
+    entry->live = false;
+    __atomic_store_n(&entry->key, NULL, __ATOMIC_RELEASE);
+    __atomic_store_n(&entry->data, NULL, __ATOMIC_RELEASE);
+
+    if (old_key != entry->inline_key && !entry->key_borrowed)
+        epoch_retire(&engine->bag, epoch_free, NULL, old_key);
+
+    if (stolen && entry->key_borrowed)
+        epoch_synchronize();
+
+    if (!stolen)
+        ht_engine_retire_data(engine, entry, old_data, entry->adopted);
+    else if (old_data == entry->inline_data)
+        *stolen = copy_from_void_ptr(entry->inline_data, entry->data_len);
+    else
+        *stolen = old_data;
+
+    epoch_retire(&engine->bag, ht_engine_reclaim_entry, engine, (void*) (uintptr_t) entry_index);
+
+    return true;
+}
+
+
+static inline double ht_engine_rehash_progress(const ht_engine *engine) {
+    const ht_index *old = engine->index->old;
+
+    if (!old)
+        return 1.0;
+
+    return (double) engine->migrate_pos / (double) old->capacity;
+}
+
+
+static void ht_engine_destroy(ht_engine *engine) {
+    for (size_t i=0; i<engine->entries_len; ++i) {
+        Entry *entry = ht_engine_entry(engine, i);
+
+        if (!entry->live)
+            continue;
+
+        if (entry->key != entry->inline_key && !entry->key_borrowed)
+            free(entry->key);
+
+        if (entry->data && entry->data != entry->inline_data)
+            release_data(entry->data, entry->adopted, engine->destructor);
     }
 
-    Entry *new_entry = (Entry*) malloc(sizeof(Entry));
+    epoch_drain(&engine->bag);
+
+    while (engine->cursors)
+        ht_engine_cursor_close(engine, engine->cursors);
+
+    for (size_t i=0; i<HASH_TABLE_SEGMENTS; ++i)
+        free(engine->segments[i]);
+
+    free(engine->holes);
+
+    if (engine->index->old)
+        ht_index_reclaim(NULL, engine->index->old);
+
+    ht_index_reclaim(NULL, engine->index);
+}
+
 
-    if (!new_entry)
+static inline size_t ht_snapshot_align(size_t n) {
+    return (n + HASH_TABLE_SNAPSHOT_ALIGN - 1) & ~(size_t) (HASH_TABLE_SNAPSHOT_ALIGN - 1);
+}
+
+
+static inline size_t ht_snapshot_record_size(size_t key_len, size_t data_len) {
+    return ht_snapshot_align(sizeof(ht_snapshot_record) + ht_snapshot_align(data_len) + key_len + 1);
+}
+
+
+static inline bool ht_snapshot_write(FILE *file, const void *data, size_t len) {
+    return len == 0 || fwrite(data, 1, len, file) == len;
+}
+
+
+static ht_save_plan* ht_engine_plan_save(const ht_engine *engine) {
+    ht_save_plan *plan = (ht_save_plan*) malloc(sizeof(ht_save_plan));
+
+    if (!plan)
         throw_memory_allocation_error();
 
-    new_entry->key = strdup(key);
-    new_entry->data = copy_from_void_ptr(data, type_size);
+    size_t capacity = HASH_TABLE_INITIAL_CAPACITY;
 
-    for (size_t i=0; i<bucket->capacity; ++i) {
-        if (!bucket->get_at(bucket, i)) {
-            bucket->set_at(bucket, new_entry, sizeof(Entry), i);
-            goto un;
-        }
+    while (ht_capacity_to_growth(capacity) < engine->size)
+        capacity *= 2;
+
+    ht_snapshot_header *header = &plan->header;
+    memset(header, 0, sizeof(*header));
+    memcpy(header->magic, HASH_TABLE_SNAPSHOT_MAGIC, sizeof(header->magic));
+
+    header->version = HASH_TABLE_SNAPSHOT_VERSION;
+    header->hash_function = HASH_FUNCTION;
+    header->seed = engine->seed;
+    header->capacity = capacity;
+    header->size = engine->size;
+    header->ctrl_offset = sizeof(*header);
+    header->slots_offset = header->ctrl_offset + capacity;
+    header->file_size = header->slots_offset + capacity * sizeof(ht_slot);
+
+    plan->index = ht_index_new(capacity);
+    memset(plan->index->slots, 0, capacity * sizeof(ht_slot));
+
+    plan->items = (ht_save_item*) malloc(MAX(engine->size, (size_t) 1) * sizeof(ht_save_item));
+    plan->len = 0;
+
+    if (!plan->items)
+        throw_memory_allocation_error();
+
+    for (size_t i=0; i<engine->entries_len; ++i) {
+        const Entry *entry = ht_engine_entry(engine, i);
+
+        if (!entry->live)
+            continue;
+
+        ht_index_set(plan->index, ht_index_find_first_non_full(plan->index, entry->hash), entry->hash, header->file_size);
+        header->file_size += ht_snapshot_record_size(entry->key_len, entry->data_len);
+
+        plan->items[plan->len++] = (ht_save_item) { entry->key, entry->data, entry->key_len, entry->data_len };
     }
 
-    bucket->set_at(bucket, new_entry, sizeof(Entry), bucket->capacity);
+    return plan;
+}
+
+
+static bool ht_save_plan_write(const ht_save_plan *plan, const char *path) {
+    static const char zeros[HASH_TABLE_SNAPSHOT_ALIGN] = { 0 };
+
+    size_t capacity = plan->header.capacity;
+    char *tmp_path = (char*) malloc(strlen(path) + 5);
+
+    if (!tmp_path)
+        throw_memory_allocation_error();
+
+    sprintf(tmp_path, "%s.tmp", path);
+
+    FILE *file = fopen(tmp_path, "wb");
+    bool ok = file != NULL;
+
+    ok = ok && ht_snapshot_write(file, &plan->header, sizeof(plan->header));
+    ok = ok && ht_snapshot_write(file, plan->index->ctrl, capacity);
+    ok = ok && ht_snapshot_write(file, plan->index->slots, capacity * sizeof(ht_slot));
+
+    for (size_t i=0; ok && i<plan->len; ++i) {
+        const ht_save_item *item = &plan->items[i];
+
+        ht_snapshot_record record = { item->key_len, item->data_len };
+        size_t data_pad = ht_snapshot_align(item->data_len) - item->data_len;
+        size_t tail_pad = ht_snapshot_record_size(item->key_len, item->data_len) - sizeof(record) - item->data_len - data_pad - item->key_len;
 
-    un:
-        UNLOCK(self->mutex);
+        ok = ok && ht_snapshot_write(file, &record, sizeof(record));
+        ok = ok && ht_snapshot_write(file, item->data, item->data_len);
+        ok = ok && ht_snapshot_write(file, zeros, data_pad);
+        ok = ok && ht_snapshot_write(file, item->key, item->key_len);
+        ok = ok && ht_snapshot_write(file, zeros, tail_pad);
+    }
+
+    if (file)
+        ok = fclose(file) == 0 && ok;
+
+    if (ok)
+        ok = rename(tmp_path, path) == 0;
+    else
+        remove(tmp_path);
+
+    free(tmp_path);
+
+    return ok;
 }
 
 
-static inline void hash_table_delete(HashTable *self, char *key) {
-    LOCK(self->mutex);
+static void ht_save_plan_free(ht_save_plan *plan) {
+    ht_index_reclaim(NULL, plan->index);
+    free(plan->items);
+    free(plan);
+}
 
-    size_t index = hash_index(key);
-    ArrayList *bucket = self->table->get_at(self->table, index);
 
-    if (bucket) {
-        for (size_t i=0; i<bucket->capacity; ++i) {
-            Entry *entry = bucket->get_at(bucket, i);
+static HashTableCursor* ht_engine_cursor_open(ht_engine *engine) {
+    HashTableCursor *cursor = (HashTableCursor*) calloc(1, sizeof(HashTableCursor));
+
+    if (!cursor)
+        throw_memory_allocation_error();
+
+    cursor->next = engine->cursors;
+
+    if (engine->cursors)
+        engine->cursors->prev = cursor;
+
+    engine->cursors = cursor;
+
+    return cursor;
+}
 
-            if (entry && strcmp(entry->key, key)==0) {
-                free(entry->key);
-                free(entry->data);
-                free(entry);
 
-                bucket->set_at(bucket, NULL, sizeof(void*), i);
-                
+static void ht_engine_cursor_close(ht_engine *engine, HashTableCursor *cursor) {
+    if (cursor->prev)
+        cursor->prev->next = cursor->next;
+    else
+        engine->cursors = cursor->next;
+
+    if (cursor->next)
+        cursor->next->prev = cursor->prev;
+
+    free(cursor->pending);
+    free(cursor);
+}
+
+
+static void ht_cursor_push(HashTableCursor *cursor, size_t entry) {
+    if (cursor->pending_len == cursor->pending_capacity) {
+        size_t new_capacity = cursor->pending_capacity ? cursor->pending_capacity * 2 : HASH_TABLE_GROUP_WIDTH;
+        size_t *new_pending = (size_t*) realloc(cursor->pending, new_capacity * sizeof(size_t));
+
+        if (!new_pending)
+            throw_memory_allocation_error();
+
+        cursor->pending = new_pending;
+        cursor->pending_capacity = new_capacity;
+    }
+
+    cursor->pending[cursor->pending_len++] = entry;
+}
+
+
+static void ht_engine_note_move(ht_engine *engine, size_t from, size_t to) {
+    for (HashTableCursor *cursor=engine->cursors; cursor; cursor=cursor->next) {
+        if (from >= cursor->position) {
+            if (to < cursor->position)
+                ht_cursor_push(cursor, to);
+            continue;
+        }
+
+        for (size_t i=0; i<cursor->pending_len; ++i) {
+            if (cursor->pending[i] == from) {
+                cursor->pending[i] = to;
                 break;
             }
         }
     }
+}
+
+
+static bool ht_engine_scan(ht_engine *engine, HashTableCursor *cursor, size_t count, ht_visit_func func, va_list args) {
+    size_t visited = 0;
+
+    while (visited < count && (cursor->pending_len > 0 || cursor->position < engine->entries_len)) {
+        size_t index = cursor->pending_len > 0 ? cursor->pending[--cursor->pending_len] : cursor->position++;
+        Entry *entry = ht_engine_entry(engine, index);
+
+        if (!entry->live)
+            continue;
+
+        va_list args_copy;
+        va_copy(args_copy, args);
+        func(entry->key, entry->key_len, entry->data, args_copy);
+        va_end(args_copy);
+
+        visited++;
+    }
+
+    return cursor->pending_len > 0 || cursor->position < engine->entries_len;
+}
+
+
+static inline void* hash_table_get(HashTable *self, char *key) {
+    return hash_table_get_bytes(self, key, strlen(key), NULL);
+}
+
+
+static inline void hash_table_set(HashTable *self, char *key, void *data, size_t type_size) {
+    hash_table_set_bytes(self, key, strlen(key), NULL, data, type_size);
+}
+
+
+static inline void hash_table_delete(HashTable *self, char *key) {
+    hash_table_delete_bytes(self, key, strlen(key), NULL);
+}
+
+
+static inline void* hash_table_get_bytes(HashTable *self, const void *key, size_t key_len, const uint64_t *hash) {
+    uint64_t h = hash ? *hash : ht_engine_hash(&self->engine, key, key_len);
+
+    epoch_enter();
+
+    Entry *entry = ht_engine_find(&self->engine, key, key_len, h);
+    void *res = entry ? __atomic_load_n(&entry->data, __ATOMIC_ACQUIRE) : NULL;
+
+    epoch_exit();
+
+    return res;
+}
+
+
+static inline void hash_table_set_bytes(HashTable *self, const void *key, size_t key_len, const uint64_t *hash, void *data, size_t type_size) {
+    uint64_t h = hash ? *hash : ht_engine_hash(&self->engine, key, key_len);
+
+    LOCK(self->mutex);
+
+    ht_engine_insert(&self->engine, key, key_len, h, data, type_size, false, false);
 
     UNLOCK(self->mutex);
 }
 
 
-static void hash_table_free(HashTable *self) {
+static inline void hash_table_delete_bytes(HashTable *self, const void *key, size_t key_len, const uint64_t *hash) {
+    uint64_t h = hash ? *hash : ht_engine_hash(&self->engine, key, key_len);
+
     LOCK(self->mutex);
 
-    for (size_t i=0; i<self->table->capacity; ++i) {
-        ArrayList *bucket = self->table->get_at(self->table, i);
-        if (!bucket) continue;
+    ht_engine_erase(&self->engine, key, key_len, h, NULL);
 
-        for (size_t j=0; j<bucket->capacity; ++j) {
-            Entry *entry = bucket->get_at(bucket, j);
+    UNLOCK(self->mutex);
+}
 
-            if (entry) {
-                free(entry->key);
-                free(entry->data);
-                free(entry);
-            }
+
+static inline void hash_table_adopt(HashTable *self, char *key, void *data, size_t type_size) {
+    hash_table_adopt_bytes(self, key, strlen(key), NULL, data, type_size);
+}
+
+
+static inline void hash_table_adopt_bytes(HashTable *self, const void *key, size_t key_len, const uint64_t *hash, void *data, size_t type_size) {
+    uint64_t h = hash ? *hash : ht_engine_hash(&self->engine, key, key_len);
+
+    LOCK(self->mutex);
+
+    ht_engine_insert(&self->engine, key, key_len, h, data, type_size, true, false);
+
+    UNLOCK(self->mutex);
+}
+
+
+static inline void* hash_table_steal(HashTable *self, char *key) {
+    return hash_table_steal_bytes(self, key, strlen(key), NULL);
+}
+
+
+static inline void* hash_table_steal_bytes(HashTable *self, const void *key, size_t key_len, const uint64_t *hash) {
+    uint64_t h = hash ? *hash : ht_engine_hash(&self->engine, key, key_len);
+    void *data = NULL;
+
+    LOCK(self->mutex);
+
+    ht_engine_erase(&self->engine, key, key_len, h, &data);
+
+    UNLOCK(self->mutex);
+
+    return data;
+}
+
+
+static void hash_table_get_many(HashTable *self, char **keys, size_t count, void **results) {
+    size_t key_lens[HASH_TABLE_BATCH];
+
+    for (size_t start=0; start<count; start+=HASH_TABLE_BATCH) {
+        size_t n = MIN(HASH_TABLE_BATCH, count - start);
+
+        for (size_t i=0; i<n; ++i)
+            key_lens[i] = strlen(keys[start + i]);
+
+        hash_table_get_many_bytes(self, (const void**) keys + start, key_lens, NULL, n, results + start);
+    }
+}
+
+
+static void hash_table_set_many(HashTable *self, char **keys, size_t count, void **data, size_t type_size) {
+    size_t key_lens[HASH_TABLE_BATCH];
+
+    LOCK(self->mutex);
+
+    for (size_t start=0; start<count; start+=HASH_TABLE_BATCH) {
+        size_t n = MIN(HASH_TABLE_BATCH, count - start);
+
+        for (size_t i=0; i<n; ++i)
+            key_lens[i] = strlen(keys[start + i]);
+
+        hash_table_set_many_bytes(self, (const void**) keys + start, key_lens, NULL, n, data + start, type_size);
+    }
+
+    UNLOCK(self->mutex);
+}
+
+
+static void hash_table_get_many_bytes(HashTable *self, const void **keys, const size_t *key_lens, const uint64_t *hashes, size_t count, void **results) {
+    uint64_t chunk_hashes[HASH_TABLE_BATCH];
+    Entry *entries[HASH_TABLE_BATCH];
+
+    epoch_enter();
+
+    for (size_t start=0; start<count; start+=HASH_TABLE_BATCH) {
+        size_t n = MIN(HASH_TABLE_BATCH, count - start);
+
+        for (size_t i=0; i<n; ++i)
+            chunk_hashes[i] = hashes ? hashes[start + i] : ht_engine_hash(&self->engine, keys[start + i], key_lens[start + i]);
+
+        ht_engine_find_batch(&self->engine, keys + start, key_lens + start, chunk_hashes, n, entries);
+
+        for (size_t i=0; i<n; ++i)
+            results[start + i] = entries[i] ? __atomic_load_n(&entries[i]->data, __ATOMIC_ACQUIRE) : NULL;
+    }
+
+    epoch_exit();
+}
+
+
+static void hash_table_set_many_bytes(HashTable *self, const void **keys, const size_t *key_lens, const uint64_t *hashes, size_t count, void **data, size_t type_size) {
+    uint64_t chunk_hashes[HASH_TABLE_BATCH];
+
+    LOCK(self->mutex);
+
+    for (size_t start=0; start<count; start+=HASH_TABLE_BATCH) {
+        size_t n = MIN(HASH_TABLE_BATCH, count - start);
+
+        for (size_t i=0; i<n; ++i) {
+            chunk_hashes[i] = hashes ? hashes[start + i] : ht_engine_hash(&self->engine, keys[start + i], key_lens[start + i]);
+            ht_engine_prefetch(&self->engine, chunk_hashes[i]);
         }
 
-        bucket->free(bucket);
+        for (size_t i=0; i<n; ++i)
+            ht_engine_insert(&self->engine, keys[start + i], key_lens[start + i], chunk_hashes[i], data[start + i], type_size, false, false);
     }
 
-    self->table->free(self->table);
+    UNLOCK(self->mutex);
+}
+
+
+static inline uint64_t hash_table_hash(HashTable *self, const void *key, size_t key_len) {
+    return ht_engine_hash(&self->engine, key, key_len);
+}
+
+
+static inline double hash_table_rehash_progress(HashTable *self) {
+    LOCK(self->mutex);
+
+    double progress = ht_engine_rehash_progress(&self->engine);
+
+    UNLOCK(self->mutex);
+
+    return progress;
+}
+
+
+static inline void hash_table_pin(HashTable *self) {
+    (void) self;
+    epoch_enter();
+}
+
+
+static inline void hash_table_unpin(HashTable *self) {
+    (void) self;
+    epoch_exit();
+}
+
+
+static void hash_table_set_destructor(HashTable *self, void (*destructor)(void *data)) {
+    LOCK(self->mutex);
+
+    self->engine.destructor = destructor;
+
+    UNLOCK(self->mutex);
+}
+
+
+static void hash_table_foreach(HashTable *self, ht_visit_func func, ...) {
+    LOCK(self->mutex);
+
+    va_list args;
+    va_start(args, func);
+
+    HashTableCursor *cursor = ht_engine_cursor_open(&self->engine);
+
+    ht_engine_scan(&self->engine, cursor, SIZE_MAX, func, args);
+    ht_engine_cursor_close(&self->engine, cursor);
+
+    va_end(args);
+
+    UNLOCK(self->mutex);
+}
+
+
+static HashTableCursor* hash_table_cursor_open(HashTable *self) {
+    LOCK(self->mutex);
+
+    HashTableCursor *cursor = ht_engine_cursor_open(&self->engine);
+
+    UNLOCK(self->mutex);
+
+    return cursor;
+}
+
+
+static bool hash_table_scan(HashTable *self, HashTableCursor *cursor, size_t count, ht_visit_func func, ...) {
+    LOCK(self->mutex);
+
+    va_list args;
+    va_start(args, func);
+
+    bool more = ht_engine_scan(&self->engine, cursor, count, func, args);
+
+    va_end(args);
+
+    UNLOCK(self->mutex);
+
+    return more;
+}
+
+
+static void hash_table_cursor_close(HashTable *self, HashTableCursor *cursor) {
+    LOCK(self->mutex);
+
+    ht_engine_cursor_close(&self->engine, cursor);
+
+    UNLOCK(self->mutex);
+}
+
+
+static bool hash_table_save(HashTable *self, const char *path) {
+    LOCK(self->mutex);
+    epoch_enter();
+
+    ht_save_plan *plan = ht_engine_plan_save(&self->engine);
+
+    UNLOCK(self->mutex);
+
+    bool ok = ht_save_plan_write(plan, path);
+
+    epoch_exit();
+    ht_save_plan_free(plan);
+
+    return ok;
+}
+
+
+static void hash_table_free(HashTable *self) {
+    LOCK(self->mutex);
+
+    ht_engine_destroy(&self->engine);
 
     UNLOCK(self->mutex);
     pthread_mutex_destroy(&self->mutex);
 
     free(self);
 }
-
@@ -0,0 +1,202 @@
+#pragma once
+
+
+#include "./internals.h"
+#include "./HashTable.h"
+
+
+typedef struct HashTableSnapshot {
+    struct HashTableSnapshot *self;
+
+    const uint8_t *base;
+    size_t length;
+
+    const ht_snapshot_header *header;
+    const int8_t *ctrl;
+    const ht_slot *slots;
+
+    void* (*get)(struct HashTableSnapshot *self, char *key);
+    void* (*get_bytes)(struct HashTableSnapshot *self, const void *key, size_t key_len, const uint64_t *hash);
+    size_t (*value_size)(struct HashTableSnapshot *self, const void *key, size_t key_len, const uint64_t *hash);
+    uint64_t (*hash)(struct HashTableSnapshot *self, const void *key, size_t key_len);
+    size_t (*size)(struct HashTableSnapshot *self);
+    void (*free)(struct HashTableSnapshot *self);
+} HashTableSnapshot;
+
+
+HashTableSnapshot* New_HashTableSnapshot(const char *path);
+static bool ht_snapshot_validate(const ht_snapshot_header *header, size_t length);
+static inline const ht_snapshot_record* ht_snapshot_record_at(const HashTableSnapshot *self, uint64_t offset);
+static const ht_snapshot_record* ht_snapshot_find(const HashTableSnapshot *self, const void *key, size_t key_len, uint64_t hash);
+static inline void* hash_table_snapshot_get(HashTableSnapshot *self, char *key);
+static inline void* hash_table_snapshot_get_bytes(HashTableSnapshot *self, const void *key, size_t key_len, const uint64_t *hash);
+static inline size_t hash_table_snapshot_value_size(HashTableSnapshot *self, const void *key, size_t key_len, const uint64_t *hash);
+static inline uint64_t hash_table_snapshot_hash(HashTableSnapshot *self, const void *key, size_t key_len);
+static inline size_t hash_table_snapshot_size(HashTableSnapshot *self);
+static void hash_table_snapshot_free(HashTableSnapshot *self);
+
+
+HashTableSnapshot* New_HashTableSnapshot(const char *path) {
+    int fd = open(path, O_RDONLY);
+
+    if (fd < 0)
+        return NULL;
+
+    struct stat st;
+
+    if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(ht_snapshot_header)) {
+        close(fd);
+        return NULL;
+    }
+
+    void *base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (base == MAP_FAILED)
+        return NULL;
+
+    if (!ht_snapshot_validate((const ht_snapshot_header*) base, st.st_size)) {
+        munmap(base, st.st_size);
+        return NULL;
+    }
+
+    madvise(base, st.st_size, MADV_RANDOM);
+
+    HashTableSnapshot *self = (HashTableSnapshot*) malloc(sizeof(HashTableSnapshot));
+
+    if (!self)
+        throw_memory_allocation_error();
+
+    self->self = self;
+
+    self->base = (const uint8_t*) base;
+    self->length = st.st_size;
+    self->header = (const ht_snapshot_header*) base;
+    self->ctrl = (const int8_t*) (self->base + self->header->ctrl_offset);
+    self->slots = (const ht_slot*) (self->base + self->header->slots_offset);
+
+    self->get = hash_table_snapshot_get;
+    self->get_bytes = hash_table_snapshot_get_bytes;
+    self->value_size = hash_table_snapshot_value_size;
+    self->hash = hash_table_snapshot_hash;
+    self->size = hash_table_snapshot_size;
+    self->free = hash_table_snapshot_free;
+
+    return self;
+}
+
+
+static bool ht_snapshot_validate(const ht_snapshot_header *header, size_t length) {
+    if (memcmp(header->magic, HASH_TABLE_SNAPSHOT_MAGIC, sizeof(header->magic)) != 0)
+        return false;
+
+    if (header->version != HASH_TABLE_SNAPSHOT_VERSION || header->hash_function != HASH_FUNCTION)
+        return false;
+
+    if (header->capacity < HASH_TABLE_GROUP_WIDTH || (header->capacity & (header->capacity - 1)) != 0)
+        return false;
+
+    if (header->capacity > length / sizeof(ht_slot) || header->size > header->capacity)
+        return false;
+
+    return header->ctrl_offset == sizeof(ht_snapshot_header)
+        && header->slots_offset == header->ctrl_offset + header->capacity
+        && header->file_size == length
+        && header->slots_offset + header->capacity * sizeof(ht_slot) <= length;
+}
+
+
+static inline const ht_snapshot_record* ht_snapshot_record_at(const HashTableSnapshot *self, uint64_t offset) {
+    uint64_t records = self->header->slots_offset + self->header->capacity * sizeof(ht_slot);
+
+    if (offset < records || offset % HASH_TABLE_SNAPSHOT_ALIGN != 0 || offset > self->length - sizeof(ht_snapshot_record))
+        return NULL;
+
+    const ht_snapshot_record *record = (const ht_snapshot_record*) (self->base + offset);
+    uint64_t available = self->length - offset - sizeof(ht_snapshot_record);
+
+    if (record->data_len > available - available % HASH_TABLE_SNAPSHOT_ALIGN)
+        return NULL;
+
+    if (record->key_len > available - ht_snapshot_align(record->data_len))
+        return NULL;
+
+    return record;
+}
+
+
+static const ht_snapshot_record* ht_snapshot_find(const HashTableSnapshot *self, const void *key, size_t key_len, uint64_t hash) {
+    size_t groups = self->header->capacity / HASH_TABLE_GROUP_WIDTH;
+    size_t group = ht_h1(hash) & (groups - 1);
+    int8_t h2 = ht_h2(hash);
+
+    for (size_t step=1; step<=groups; ++step) {
+        size_t base = group * HASH_TABLE_GROUP_WIDTH;
+        uint64_t ctrl = ht_group_load(self->ctrl + base);
+        uint64_t match = ht_group_match(ctrl, h2);
+
+        while (match) {
+            const ht_slot *slot = &self->slots[base + ht_mask_next(&match)];
+
+            if (slot->hash != hash)
+                continue;
+
+            const ht_snapshot_record *record = ht_snapshot_record_at(self, slot->entry);
+
+            if (!record)
+                continue;
+
+            const char *record_key = (const char*) (record + 1) + ht_snapshot_align(record->data_len);
+
+            if (record->key_len == key_len && memcmp(record_key, key, key_len) == 0)
+                return record;
+        }
+
+        if (ht_group_match_empty(ctrl))
+            return NULL;
+
+        group = (group + step) & (groups - 1);
+    }
+
+    return NULL;
+}
+
+
+static inline void* hash_table_snapshot_get(HashTableSnapshot *self, char *key) {
+    return hash_table_snapshot_get_bytes(self, key, strlen(key), NULL);
+}
+
+
+static inline void* hash_table_snapshot_get_bytes(HashTableSnapshot *self, const void *key, size_t key_len, const uint64_t *hash) {
+    uint64_t h = hash ? *hash : hash_bytes(key, key_len, self->header->seed);
+    const ht_snapshot_record *record = ht_snapshot_find(self, key, key_len, h);
+
+    if (!record || record->data_len == 0)
+        return NULL;
+
+    return (void*) (record + 1);
+}
+
+
+static inline size_t hash_table_snapshot_value_size(HashTableSnapshot *self, const void *key, size_t key_len, const uint64_t *hash) {
+    uint64_t h = hash ? *hash : hash_bytes(key, key_len, self->header->seed);
+    const ht_snapshot_record *record = ht_snapshot_find(self, key, key_len, h);
+
+    return record ? record->data_len : 0;
+}
+
+
+static inline uint64_t hash_table_snapshot_hash(HashTableSnapshot *self, const void *key, size_t key_len) {
+    return hash_bytes(key, key_len, self->header->seed);
+}
+
+
+static inline size_t hash_table_snapshot_size(HashTableSnapshot *self) {
+    return self->header->size;
+}
+
+
+static void hash_table_snapshot_free(HashTableSnapshot *self) {
+    munmap((void*) self->base, self->length);
+    free(self);
+}
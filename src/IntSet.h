@@ -0,0 +1,1163 @@
+#pragma once
+
+
+#include "./internals.h"
+
+
+#define INT_SET_ARRAY_MAX 4096
+#define INT_SET_BITMAP_WORDS 1024
+#define INT_SET_CHUNK_SPAN 65536
+#define INT_SET_BULK_MIN 16
+#define INT_SET_GALLOP_SKEW 32
+#define INT_SET_PARALLEL_THRESHOLD (1 << 20)
+#define INT_SET_MAX_THREADS 16
+
+
+typedef enum int_set_kind {
+    INT_SET_ARRAY,
+    INT_SET_BITMAP,
+    INT_SET_RUN
+} int_set_kind;
+
+
+typedef enum int_set_op {
+    INT_SET_UNION,
+    INT_SET_INTERSECTION,
+    INT_SET_DIFFERENCE
+} int_set_op;
+
+
+typedef struct int_set_container {
+    void *data;
+    uint32_t cardinality;
+    uint32_t runs;
+    uint32_t capacity;
+    uint16_t key;
+    uint8_t kind;
+} int_set_container;
+
+
+typedef struct int_set_pair {
+    const int_set_container *a;
+    const int_set_container *b;
+    int_set_container out;
+} int_set_pair;
+
+
+typedef struct int_set_combine_job {
+    int_set_pair *pairs;
+    size_t lo;
+    size_t hi;
+    int_set_op op;
+} int_set_combine_job;
+
+
+typedef struct IntSet {
+    struct IntSet *self;
+
+    int_set_container *chunks;
+    size_t count;
+    size_t capacity;
+    size_t cardinality;
+
+    pthread_rwlock_t lock;
+
+    void (*insert)(struct IntSet *self, uint32_t value);
+    void (*insert_many)(struct IntSet *self, const uint32_t *values, size_t count);
+    void (*delete)(struct IntSet *self, uint32_t value);
+    bool (*lookup)(struct IntSet *self, uint32_t value);
+    size_t (*size)(struct IntSet *self);
+    void (*optimize)(struct IntSet *self);
+    size_t (*memory_usage)(struct IntSet *self);
+    void (*foreach)(struct IntSet *self, void (*func)(uint32_t value, va_list args), ...);
+    struct IntSet* (*unite)(struct IntSet *self, struct IntSet *other);
+    struct IntSet* (*intersect)(struct IntSet *self, struct IntSet *other);
+    struct IntSet* (*subtract)(struct IntSet *self, struct IntSet *other);
+    bool (*is_subset)(struct IntSet *self, struct IntSet *other);
+    void (*free)(struct IntSet *self);
+} IntSet;
+
+
+IntSet* New_IntSet();
+static inline size_t int_set_chunk_search(const IntSet *self, uint16_t key);
+static inline size_t int_set_array_search(const uint16_t *values, size_t n, uint16_t low);
+static inline size_t int_set_run_search(const uint16_t *runs, size_t n, uint16_t low);
+static inline uint32_t int_set_bitmap_cardinality(const uint64_t *words);
+static int_set_container* int_set_chunk_insert(IntSet *self, size_t index, uint16_t key);
+static void int_set_chunk_remove(IntSet *self, size_t index);
+static void int_set_array_reserve(int_set_container *c, size_t capacity);
+static void int_set_array_to_bitmap(int_set_container *c);
+static void int_set_bitmap_to_array(int_set_container *c);
+static void int_set_run_expand(int_set_container *c);
+static size_t int_set_count_runs(const int_set_container *c);
+static void int_set_to_runs(int_set_container *c, size_t runs);
+static size_t int_set_container_bytes(const int_set_container *c);
+static bool int_set_container_lookup(const int_set_container *c, uint16_t low);
+static bool int_set_container_insert(int_set_container *c, uint16_t low);
+static bool int_set_container_delete(int_set_container *c, uint16_t low);
+static void int_set_container_insert_many(int_set_container *c, const uint32_t *values, size_t n);
+static int int_set_compare_low(const void *a, const void *b);
+static void int_set_insert(IntSet *self, uint32_t value);
+static void int_set_insert_many(IntSet *self, const uint32_t *values, size_t count);
+static void int_set_delete(IntSet *self, uint32_t value);
+static bool int_set_lookup(IntSet *self, uint32_t value);
+static size_t int_set_size(IntSet *self);
+static void int_set_optimize(IntSet *self);
+static size_t int_set_memory_usage(IntSet *self);
+static inline void int_set_visit(void (*func)(uint32_t value, va_list args), uint32_t value, va_list args);
+static void int_set_foreach(IntSet *self, void (*func)(uint32_t value, va_list args), ...);
+static void int_set_container_clone(const int_set_container *src, int_set_container *out);
+static const int_set_container* int_set_container_view(const int_set_container *c, int_set_container *tmp);
+static void int_set_container_normalize(int_set_container *c);
+static size_t int_set_array_combine(const uint16_t *a, size_t na, const uint16_t *b, size_t nb, int_set_op op, uint16_t *out);
+static void int_set_container_combine(const int_set_container *a, const int_set_container *b, int_set_op op, int_set_container *out);
+static void* int_set_combine_worker(void *arg);
+static void int_set_lock_pair(IntSet *a, IntSet *b);
+static void int_set_unlock_pair(IntSet *a, IntSet *b);
+static IntSet* int_set_combine(IntSet *self, IntSet *other, int_set_op op);
+static IntSet* int_set_unite(IntSet *self, IntSet *other);
+static IntSet* int_set_intersect(IntSet *self, IntSet *other);
+static IntSet* int_set_subtract(IntSet *self, IntSet *other);
+static bool int_set_is_subset(IntSet *self, IntSet *other);
+static void int_set_free(IntSet *self);
+
+
+IntSet* New_IntSet() {
+    IntSet *self = (IntSet*) malloc(sizeof(IntSet));
+
+    if (!self)
+        throw_memory_allocation_error();
+
+    self->self = self;
+
+    self->chunks = NULL;
+    self->count = 0;
+    self->capacity = 0;
+    self->cardinality = 0;
+
+    pthread_rwlock_init(&self->lock, NULL);
+
+    self->insert = int_set_insert;
+    self->insert_many = int_set_insert_many;
+    self->delete = int_set_delete;
+    self->lookup = int_set_lookup;
+    self->size = int_set_size;
+    self->optimize = int_set_optimize;
+    self->memory_usage = int_set_memory_usage;
+    self->foreach = int_set_foreach;
+    self->unite = int_set_unite;
+    self->intersect = int_set_intersect;
+    self->subtract = int_set_subtract;
+    self->is_subset = int_set_is_subset;
+    self->free = int_set_free;
+
+    return self;
+}
+
+
+static inline size_t int_set_chunk_search(const IntSet *self, uint16_t key) {
+    size_t lo = 0;
+    size_t hi = self->count;
+
+    if (hi > 0 && self->chunks[hi - 1].key < key)
+        return hi;
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+
+        if (self->chunks[mid].key < key)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return lo;
+}
+
+
+static inline size_t int_set_array_search(const uint16_t *values, size_t n, uint16_t low) {
+    size_t lo = 0;
+    size_t hi = n;
+
+    if (hi > 0 && values[hi - 1] < low)
+        return hi;
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+
+        if (values[mid] < low)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return lo;
+}
+
+
+static inline size_t int_set_run_search(const uint16_t *runs, size_t n, uint16_t low) {
+    size_t lo = 0;
+    size_t hi = n;
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+
+        if (runs[2 * mid] <= low)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return lo;
+}
+
+
+static inline uint32_t int_set_bitmap_cardinality(const uint64_t *words) {
+    uint32_t cardinality = 0;
+
+    for (size_t i=0; i<INT_SET_BITMAP_WORDS; ++i)
+        cardinality += __builtin_popcountll(words[i]);
+
+    return cardinality;
+}
+
+
+static int_set_container* int_set_chunk_insert(IntSet *self, size_t index, uint16_t key) {
+    if (self->count == self->capacity) {
+        size_t capacity = self->capacity ? self->capacity * 2 : 4;
+        int_set_container *chunks = (int_set_container*) realloc(self->chunks, capacity * sizeof(int_set_container));
+
+        if (!chunks)
+            throw_memory_allocation_error();
+
+        self->chunks = chunks;
+        self->capacity = capacity;
+    }
+
+    memmove(self->chunks + index + 1, self->chunks + index, (self->count - index) * sizeof(int_set_container));
+    self->count++;
+
+    int_set_container *c = &self->chunks[index];
+
+    c->data = NULL;
+    c->cardinality = 0;
+    c->runs = 0;
+    c->capacity = 0;
+    c->key = key;
+    c->kind = INT_SET_ARRAY;
+
+    return c;
+}
+
+
+static void int_set_chunk_remove(IntSet *self, size_t index) {
+    free(self->chunks[index].data);
+
+    memmove(self->chunks + index, self->chunks + index + 1, (self->count - index - 1) * sizeof(int_set_container));
+    self->count--;
+}
+
+
+static void int_set_array_reserve(int_set_container *c, size_t capacity) {
+    if (capacity <= c->capacity)
+        return;
+
+    size_t new_capacity = c->capacity ? c->capacity : 4;
+
+    while (new_capacity < capacity)
+        new_capacity *= 2;
+
+    new_capacity = MIN(new_capacity, (size_t) INT_SET_ARRAY_MAX);
+
+    uint16_t *values = (uint16_t*) realloc(c->data, new_capacity * sizeof(uint16_t));
+
+    if (!values)
+        throw_memory_allocation_error();
+
+    c->data = values;
+    c->capacity = new_capacity;
+}
+
+
+static void int_set_array_to_bitmap(int_set_container *c) {
+    uint64_t *words = (uint64_t*) calloc(INT_SET_BITMAP_WORDS, sizeof(uint64_t));
+    const uint16_t *values = (const uint16_t*) c->data;
+
+    if (!words)
+        throw_memory_allocation_error();
+
+    for (size_t i=0; i<c->cardinality; ++i)
+        words[values[i] >> 6] |= 1ULL << (values[i] & 63);
+
+    free(c->data);
+
+    c->data = words;
+    c->capacity = 0;
+    c->kind = INT_SET_BITMAP;
+}
+
+
+static void int_set_bitmap_to_array(int_set_container *c) {
+    const uint64_t *words = (const uint64_t*) c->data;
+    uint16_t *values = (uint16_t*) malloc(MAX(c->cardinality, 1) * sizeof(uint16_t));
+    size_t n = 0;
+
+    if (!values)
+        throw_memory_allocation_error();
+
+    for (size_t i=0; i<INT_SET_BITMAP_WORDS; ++i) {
+        uint64_t word = words[i];
+
+        while (word) {
+            values[n++] = (uint16_t) (i * 64 + __builtin_ctzll(word));
+            word &= word - 1;
+        }
+    }
+
+    free(c->data);
+
+    c->data = values;
+    c->capacity = MAX(c->cardinality, 1);
+    c->kind = INT_SET_ARRAY;
+}
+
+
+static void int_set_run_expand(int_set_container *c) {
+    const uint16_t *runs = (const uint16_t*) c->data;
+
+    if (c->cardinality > INT_SET_ARRAY_MAX) {
+        uint64_t *words = (uint64_t*) calloc(INT_SET_BITMAP_WORDS, sizeof(uint64_t));
+
+        if (!words)
+            throw_memory_allocation_error();
+
+        for (size_t r=0; r<c->runs; ++r) {
+            for (uint32_t v=runs[2 * r]; v<=(uint32_t) runs[2 * r] + runs[2 * r + 1]; ++v)
+                words[v >> 6] |= 1ULL << (v & 63);
+        }
+
+        free(c->data);
+
+        c->data = words;
+        c->capacity = 0;
+        c->kind = INT_SET_BITMAP;
+    } else {
+        uint16_t *values = (uint16_t*) malloc(c->cardinality * sizeof(uint16_t));
+        size_t n = 0;
+
+        if (!values)
+            throw_memory_allocation_error();
+
+        for (size_t r=0; r<c->runs; ++r) {
+            for (uint32_t v=runs[2 * r]; v<=(uint32_t) runs[2 * r] + runs[2 * r + 1]; ++v)
+                values[n++] = (uint16_t) v;
+        }
+
+        free(c->data);
+
+        c->data = values;
+        c->capacity = c->cardinality;
+        c->kind = INT_SET_ARRAY;
+    }
+
+    c->runs = 0;
+}
+
+
+static size_t int_set_count_runs(const int_set_container *c) {
+    size_t runs = 0;
+
+    if (c->kind == INT_SET_RUN)
+        return c->runs;
+
+    if (c->kind == INT_SET_ARRAY) {
+        const uint16_t *values = (const uint16_t*) c->data;
+
+        for (size_t i=0; i<c->cardinality; ++i) {
+            if (i == 0 || values[i] != values[i - 1] + 1)
+                runs++;
+        }
+
+        return runs;
+    }
+
+    const uint64_t *words = (const uint64_t*) c->data;
+    uint64_t carry = 0;
+
+    for (size_t i=0; i<INT_SET_BITMAP_WORDS; ++i) {
+        runs += __builtin_popcountll(words[i] & ~((words[i] << 1) | carry));
+        carry = words[i] >> 63;
+    }
+
+    return runs;
+}
+
+
+static void int_set_to_runs(int_set_container *c, size_t runs) {
+    uint16_t *pairs = (uint16_t*) malloc(2 * runs * sizeof(uint16_t));
+    size_t n = 0;
+
+    if (!pairs)
+        throw_memory_allocation_error();
+
+    if (c->kind == INT_SET_ARRAY) {
+        const uint16_t *values = (const uint16_t*) c->data;
+
+        for (size_t i=0; i<c->cardinality; ++i) {
+            if (n > 0 && values[i] == pairs[2 * n - 2] + pairs[2 * n - 1] + 1) {
+                pairs[2 * n - 1]++;
+            } else {
+                pairs[2 * n] = values[i];
+                pairs[2 * n + 1] = 0;
+                n++;
+            }
+        }
+    } else {
+        const uint64_t *words = (const uint64_t*) c->data;
+
+        for (size_t i=0; i<INT_SET_BITMAP_WORDS; ++i) {
+            uint64_t word = words[i];
+
+            while (word) {
+                uint32_t lo = __builtin_ctzll(word);
+                uint64_t filled = word | ((1ULL << lo) - 1);
+                uint32_t hi = ~filled ? __builtin_ctzll(~filled) : 64;
+                uint32_t start = i * 64 + lo;
+
+                if (n > 0 && start == pairs[2 * n - 2] + pairs[2 * n - 1] + 1u) {
+                    pairs[2 * n - 1] += hi - lo;
+                } else {
+                    pairs[2 * n] = (uint16_t) start;
+                    pairs[2 * n + 1] = (uint16_t) (hi - lo - 1);
+                    n++;
+                }
+
+                word = hi == 64 ? 0 : word & ~((1ULL << hi) - 1);
+            }
+        }
+    }
+
+    free(c->data);
+
+    c->data = pairs;
+    c->runs = runs;
+    c->capacity = 2 * runs;
+    c->kind = INT_SET_RUN;
+}
+
+
+static size_t int_set_container_bytes(const int_set_container *c) {
+    if (c->kind == INT_SET_BITMAP)
+        return INT_SET_BITMAP_WORDS * sizeof(uint64_t);
+
+    return c->capacity * sizeof(uint16_t);
+}
+
+
+static bool int_set_container_lookup(const int_set_container *c, uint16_t low) {
+    if (c->kind == INT_SET_BITMAP)
+        return (((const uint64_t*) c->data)[low >> 6] >> (low & 63)) & 1;
+
+    if (c->kind == INT_SET_ARRAY) {
+        const uint16_t *values = (const uint16_t*) c->data;
+        size_t i = int_set_array_search(values, c->cardinality, low);
+
+        return i < c->cardinality && values[i] == low;
+    }
+
+    const uint16_t *runs = (const uint16_t*) c->data;
+    size_t r = int_set_run_search(runs, c->runs, low);
+
+    return r > 0 && low - runs[2 * (r - 1)] <= runs[2 * (r - 1) + 1];
+}
+
+
+static bool int_set_container_insert(int_set_container *c, uint16_t low) {
+    if (c->kind == INT_SET_RUN) {
+        if (int_set_container_lookup(c, low))
+            return false;
+
+        int_set_run_expand(c);
+    }
+
+    if (c->kind == INT_SET_BITMAP) {
+        uint64_t *word = &((uint64_t*) c->data)[low >> 6];
+        uint64_t bit = 1ULL << (low & 63);
+
+        if (*word & bit)
+            return false;
+
+        *word |= bit;
+        c->cardinality++;
+
+        return true;
+    }
+
+    size_t i = int_set_array_search((const uint16_t*) c->data, c->cardinality, low);
+
+    if (i < c->cardinality && ((const uint16_t*) c->data)[i] == low)
+        return false;
+
+    if (c->cardinality == INT_SET_ARRAY_MAX) {
+        int_set_array_to_bitmap(c);
+
+        return int_set_container_insert(c, low);
+    }
+
+    int_set_array_reserve(c, c->cardinality + 1);
+
+    uint16_t *values = (uint16_t*) c->data;
+
+    memmove(values + i + 1, values + i, (c->cardinality - i) * sizeof(uint16_t));
+    values[i] = low;
+    c->cardinality++;
+
+    return true;
+}
+
+
+static bool int_set_container_delete(int_set_container *c, uint16_t low) {
+    if (!int_set_container_lookup(c, low))
+        return false;
+
+    if (c->kind == INT_SET_RUN)
+        int_set_run_expand(c);
+
+    if (c->kind == INT_SET_BITMAP) {
+        ((uint64_t*) c->data)[low >> 6] &= ~(1ULL << (low & 63));
+        c->cardinality--;
+
+        if (c->cardinality <= INT_SET_ARRAY_MAX)
+            int_set_bitmap_to_array(c);
+
+        return true;
+    }
+
+    uint16_t *values = (uint16_t*) c->data;
+    size_t i = int_set_array_search(values, c->cardinality, low);
+
+    memmove(values + i, values + i + 1, (c->cardinality - i - 1) * sizeof(uint16_t));
+    c->cardinality--;
+
+    return true;
+}
+
+
+static int int_set_compare_low(const void *a, const void *b) {
+    uint16_t x = *(const uint16_t*) a;
+    uint16_t y = *(const uint16_t*) b;
+
+    return (x > y) - (x < y);
+}
+
+
+static void int_set_container_insert_many(int_set_container *c, const uint32_t *values, size_t n) {
+    if (c->kind == INT_SET_RUN)
+        int_set_run_expand(c);
+
+    if (c->kind == INT_SET_ARRAY && c->cardinality + n > INT_SET_ARRAY_MAX)
+        int_set_array_to_bitmap(c);
+
+    if (c->kind == INT_SET_BITMAP) {
+        uint64_t *words = (uint64_t*) c->data;
+
+        for (size_t i=0; i<n; ++i)
+            words[(values[i] & 0xFFFF) >> 6] |= 1ULL << (values[i] & 63);
+
+        c->cardinality = int_set_bitmap_cardinality(words);
+
+        if (c->cardinality <= INT_SET_ARRAY_MAX)
+            int_set_bitmap_to_array(c);
+
+        return;
+    }
+
+    uint16_t *incoming = (uint16_t*) malloc(n * sizeof(uint16_t));
+    size_t capacity = c->cardinality + n;
+    uint16_t *merged = (uint16_t*) malloc(capacity * sizeof(uint16_t));
+    const uint16_t *existing = (const uint16_t*) c->data;
+    bool sorted = true;
+
+    if (!incoming || !merged)
+        throw_memory_allocation_error();
+
+    for (size_t i=0; i<n; ++i) {
+        incoming[i] = (uint16_t) values[i];
+
+        if (i > 0 && incoming[i] < incoming[i - 1])
+            sorted = false;
+    }
+
+    if (!sorted)
+        qsort(incoming, n, sizeof(uint16_t), int_set_compare_low);
+
+    size_t i = 0, j = 0, k = 0;
+
+    while (i < c->cardinality || j < n) {
+        uint16_t next;
+
+        if (j == n || (i < c->cardinality && existing[i] <= incoming[j]))
+            next = existing[i++];
+        else
+            next = incoming[j++];
+
+        if (k == 0 || merged[k - 1] != next)
+            merged[k++] = next;
+    }
+
+    free(incoming);
+    free(c->data);
+
+    c->data = merged;
+    c->cardinality = k;
+    c->capacity = capacity;
+}
+
+
+static void int_set_insert(IntSet *self, uint32_t value) {
+    uint16_t key = value >> 16;
+
+    WRITE_LOCK(self->lock);
+
+    size_t index = int_set_chunk_search(self, key);
+
+    if (index == self->count || self->chunks[index].key != key)
+        int_set_chunk_insert(self, index, key);
+
+    if (int_set_container_insert(&self->chunks[index], (uint16_t) value))
+        self->cardinality++;
+
+    RW_UNLOCK(self->lock);
+}
+
+
+static void int_set_insert_many(IntSet *self, const uint32_t *values, size_t count) {
+    WRITE_LOCK(self->lock);
+
+    size_t start = 0;
+
+    while (start < count) {
+        uint16_t key = values[start] >> 16;
+        size_t end = start + 1;
+
+        while (end < count && (values[end] >> 16) == key)
+            end++;
+
+        size_t index = int_set_chunk_search(self, key);
+
+        if (index == self->count || self->chunks[index].key != key)
+            int_set_chunk_insert(self, index, key);
+
+        int_set_container *c = &self->chunks[index];
+        size_t before = c->cardinality;
+
+        if (end - start < INT_SET_BULK_MIN) {
+            for (size_t i=start; i<end; ++i)
+                int_set_container_insert(c, (uint16_t) values[i]);
+        } else {
+            int_set_container_insert_many(c, values + start, end - start);
+        }
+
+        self->cardinality += c->cardinality - before;
+        start = end;
+    }
+
+    RW_UNLOCK(self->lock);
+}
+
+
+static void int_set_delete(IntSet *self, uint32_t value) {
+    uint16_t key = value >> 16;
+
+    WRITE_LOCK(self->lock);
+
+    size_t index = int_set_chunk_search(self, key);
+
+    if (index == self->count || self->chunks[index].key != key)
+        goto un;
+
+    if (!int_set_container_delete(&self->chunks[index], (uint16_t) value))
+        goto un;
+
+    self->cardinality--;
+
+    if (self->chunks[index].cardinality == 0)
+        int_set_chunk_remove(self, index);
+
+    un:
+        RW_UNLOCK(self->lock);
+}
+
+
+static bool int_set_lookup(IntSet *self, uint32_t value) {
+    uint16_t key = value >> 16;
+
+    READ_LOCK(self->lock);
+
+    size_t index = int_set_chunk_search(self, key);
+    bool res = index < self->count && self->chunks[index].key == key && int_set_container_lookup(&self->chunks[index], (uint16_t) value);
+
+    RW_UNLOCK(self->lock);
+
+    return res;
+}
+
+
+static size_t int_set_size(IntSet *self) {
+    READ_LOCK(self->lock);
+
+    size_t size = self->cardinality;
+
+    RW_UNLOCK(self->lock);
+
+    return size;
+}
+
+
+static void int_set_optimize(IntSet *self) {
+    WRITE_LOCK(self->lock);
+
+    for (size_t i=0; i<self->count; ++i) {
+        int_set_container *c = &self->chunks[i];
+
+        if (c->kind == INT_SET_RUN)
+            continue;
+
+        size_t runs = int_set_count_runs(c);
+        size_t run_bytes = 2 * runs * sizeof(uint16_t);
+        size_t array_bytes = c->cardinality * sizeof(uint16_t);
+        size_t bitmap_bytes = INT_SET_BITMAP_WORDS * sizeof(uint64_t);
+
+        if (run_bytes < MIN(array_bytes, bitmap_bytes)) {
+            int_set_to_runs(c, runs);
+        } else if (c->kind == INT_SET_ARRAY && c->capacity > c->cardinality) {
+            c->data = realloc(c->data, c->cardinality * sizeof(uint16_t));
+            c->capacity = c->cardinality;
+
+            if (!c->data)
+                throw_memory_allocation_error();
+        }
+    }
+
+    if (self->capacity > self->count && self->count > 0) {
+        self->chunks = (int_set_container*) realloc(self->chunks, self->count * sizeof(int_set_container));
+        self->capacity = self->count;
+
+        if (!self->chunks)
+            throw_memory_allocation_error();
+    }
+
+    RW_UNLOCK(self->lock);
+}
+
+
+static size_t int_set_memory_usage(IntSet *self) {
+    READ_LOCK(self->lock);
+
+    size_t bytes = sizeof(IntSet) + self->capacity * sizeof(int_set_container);
+
+    for (size_t i=0; i<self->count; ++i)
+        bytes += int_set_container_bytes(&self->chunks[i]);
+
+    RW_UNLOCK(self->lock);
+
+    return bytes;
+}
+
+
+static inline void int_set_visit(void (*func)(uint32_t value, va_list args), uint32_t value, va_list args) {
+    va_list args_copy;
+    va_copy(args_copy, args);
+    func(value, args_copy);
+    va_end(args_copy);
+}
+
+
+static void int_set_foreach(IntSet *self, void (*func)(uint32_t value, va_list args), ...) {
+    READ_LOCK(self->lock);
+
+    va_list args;
+    va_start(args, func);
+
+    for (size_t i=0; i<self->count; ++i) {
+        const int_set_container *c = &self->chunks[i];
+        uint32_t high = (uint32_t) c->key << 16;
+
+        if (c->kind == INT_SET_ARRAY) {
+            const uint16_t *values = (const uint16_t*) c->data;
+
+            for (size_t j=0; j<c->cardinality; ++j)
+                int_set_visit(func, high | values[j], args);
+        } else if (c->kind == INT_SET_BITMAP) {
+            const uint64_t *words = (const uint64_t*) c->data;
+
+            for (size_t w=0; w<INT_SET_BITMAP_WORDS; ++w) {
+                for (uint64_t word=words[w]; word; word&=word - 1)
+                    int_set_visit(func, high | (uint32_t) (w * 64 + __builtin_ctzll(word)), args);
+            }
+        } else {
+            const uint16_t *runs = (const uint16_t*) c->data;
+
+            for (size_t r=0; r<c->runs; ++r) {
+                for (uint32_t v=runs[2 * r]; v<=(uint32_t) runs[2 * r] + runs[2 * r + 1]; ++v)
+                    int_set_visit(func, high | v, args);
+            }
+        }
+    }
+
+    va_end(args);
+
+    RW_UNLOCK(self->lock);
+}
+
+
+static void int_set_container_clone(const int_set_container *src, int_set_container *out) {
+    size_t bytes = src->kind == INT_SET_BITMAP ? INT_SET_BITMAP_WORDS * sizeof(uint64_t)
+                 : src->kind == INT_SET_RUN ? 2 * src->runs * sizeof(uint16_t)
+                 : src->cardinality * sizeof(uint16_t);
+
+    *out = *src;
+    out->data = malloc(MAX(bytes, 1));
+
+    if (!out->data)
+        throw_memory_allocation_error();
+
+    memcpy(out->data, src->data, bytes);
+
+    if (src->kind != INT_SET_BITMAP)
+        out->capacity = bytes / sizeof(uint16_t);
+}
+
+
+static const int_set_container* int_set_container_view(const int_set_container *c, int_set_container *tmp) {
+    if (!c || c->kind != INT_SET_RUN)
+        return c;
+
+    int_set_container_clone(c, tmp);
+    int_set_run_expand(tmp);
+
+    return tmp;
+}
+
+
+static void int_set_container_normalize(int_set_container *c) {
+    if (c->kind == INT_SET_BITMAP && c->cardinality > 0 && c->cardinality <= INT_SET_ARRAY_MAX)
+        int_set_bitmap_to_array(c);
+    else if (c->kind == INT_SET_ARRAY && c->cardinality > INT_SET_ARRAY_MAX)
+        int_set_array_to_bitmap(c);
+}
+
+
+static size_t int_set_array_combine(const uint16_t *a, size_t na, const uint16_t *b, size_t nb, int_set_op op, uint16_t *out) {
+    size_t i = 0, j = 0, k = 0;
+
+    if (op == INT_SET_INTERSECTION && MIN(na, nb) * INT_SET_GALLOP_SKEW < MAX(na, nb)) {
+        const uint16_t *small = na < nb ? a : b;
+        const uint16_t *large = na < nb ? b : a;
+        size_t n_small = MIN(na, nb);
+        size_t n_large = MAX(na, nb);
+
+        for (i=0; i<n_small && j<n_large; ++i) {
+            j += int_set_array_search(large + j, n_large - j, small[i]);
+
+            if (j < n_large && large[j] == small[i])
+                out[k++] = small[i];
+        }
+
+        return k;
+    }
+
+    while (i < na && j < nb) {
+        if (a[i] < b[j]) {
+            if (op != INT_SET_INTERSECTION)
+                out[k++] = a[i];
+            i++;
+        } else if (a[i] > b[j]) {
+            if (op == INT_SET_UNION)
+                out[k++] = b[j];
+            j++;
+        } else {
+            if (op != INT_SET_DIFFERENCE)
+                out[k++] = a[i];
+            i++;
+            j++;
+        }
+    }
+
+    if (op != INT_SET_INTERSECTION) {
+        memcpy(out + k, a + i, (na - i) * sizeof(uint16_t));
+        k += na - i;
+    }
+
+    if (op == INT_SET_UNION) {
+        memcpy(out + k, b + j, (nb - j) * sizeof(uint16_t));
+        k += nb - j;
+    }
+
+    return k;
+}
+
+
+static void int_set_container_combine(const int_set_container *a, const int_set_container *b, int_set_op op, int_set_container *out) {
+    int_set_container a_tmp, b_tmp;
+
+    if (!a || !b) {
+        int_set_container_clone(a ? a : b, out);
+        return;
+    }
+
+    a = int_set_container_view(a, &a_tmp);
+    b = int_set_container_view(b, &b_tmp);
+
+    if (a->kind == INT_SET_BITMAP && b->kind == INT_SET_BITMAP) {
+        const uint64_t *x = (const uint64_t*) a->data;
+        const uint64_t *y = (const uint64_t*) b->data;
+        uint64_t *words = (uint64_t*) malloc(INT_SET_BITMAP_WORDS * sizeof(uint64_t));
+
+        if (!words)
+            throw_memory_allocation_error();
+
+        for (size_t i=0; i<INT_SET_BITMAP_WORDS; ++i)
+            words[i] = op == INT_SET_UNION ? x[i] | y[i] : op == INT_SET_INTERSECTION ? x[i] & y[i] : x[i] & ~y[i];
+
+        *out = *a;
+        out->data = words;
+        out->cardinality = int_set_bitmap_cardinality(words);
+    } else if (a->kind == INT_SET_ARRAY && b->kind == INT_SET_ARRAY) {
+        size_t capacity = op == INT_SET_UNION ? a->cardinality + b->cardinality : a->cardinality;
+        uint16_t *values = (uint16_t*) malloc(MAX(capacity, 1) * sizeof(uint16_t));
+
+        if (!values)
+            throw_memory_allocation_error();
+
+        *out = *a;
+        out->data = values;
+        out->cardinality = int_set_array_combine((const uint16_t*) a->data, a->cardinality, (const uint16_t*) b->data, b->cardinality, op, values);
+        out->capacity = MAX(capacity, 1);
+    } else if (op == INT_SET_UNION || (op == INT_SET_DIFFERENCE && a->kind == INT_SET_BITMAP)) {
+        const int_set_container *bitmap = a->kind == INT_SET_BITMAP ? a : b;
+        const int_set_container *array = bitmap == a ? b : a;
+        const uint16_t *values = (const uint16_t*) array->data;
+
+        int_set_container_clone(bitmap, out);
+        out->key = a->key;
+
+        uint64_t *words = (uint64_t*) out->data;
+
+        for (size_t i=0; i<array->cardinality; ++i) {
+            if (op == INT_SET_UNION)
+                words[values[i] >> 6] |= 1ULL << (values[i] & 63);
+            else
+                words[values[i] >> 6] &= ~(1ULL << (values[i] & 63));
+        }
+
+        out->cardinality = int_set_bitmap_cardinality(words);
+    } else {
+        const int_set_container *bitmap = a->kind == INT_SET_BITMAP ? a : b;
+        const int_set_container *array = bitmap == a ? b : a;
+        const uint16_t *values = (const uint16_t*) array->data;
+        const uint64_t *words = (const uint64_t*) bitmap->data;
+        uint16_t *kept = (uint16_t*) malloc(MAX(array->cardinality, 1) * sizeof(uint16_t));
+        size_t k = 0;
+
+        if (!kept)
+            throw_memory_allocation_error();
+
+        for (size_t i=0; i<array->cardinality; ++i) {
+            bool present = (words[values[i] >> 6] >> (values[i] & 63)) & 1;
+
+            if (present == (op == INT_SET_INTERSECTION))
+                kept[k++] = values[i];
+        }
+
+        *out = *array;
+        out->data = kept;
+        out->cardinality = k;
+        out->capacity = MAX(array->cardinality, 1);
+        out->key = a->key;
+    }
+
+    if (a == &a_tmp)
+        free(a_tmp.data);
+
+    if (b == &b_tmp)
+        free(b_tmp.data);
+
+    int_set_container_normalize(out);
+}
+
+
+static void* int_set_combine_worker(void *arg) {
+    int_set_combine_job *job = (int_set_combine_job*) arg;
+
+    for (size_t i=job->lo; i<job->hi; ++i)
+        int_set_container_combine(job->pairs[i].a, job->pairs[i].b, job->op, &job->pairs[i].out);
+
+    return NULL;
+}
+
+
+static void int_set_lock_pair(IntSet *a, IntSet *b) {
+    if ((uintptr_t) a > (uintptr_t) b) {
+        IntSet *tmp = a;
+        a = b;
+        b = tmp;
+    }
+
+    READ_LOCK(a->lock);
+
+    if (a != b)
+        READ_LOCK(b->lock);
+}
+
+
+static void int_set_unlock_pair(IntSet *a, IntSet *b) {
+    if (a != b)
+        RW_UNLOCK(b->lock);
+
+    RW_UNLOCK(a->lock);
+}
+
+
+static IntSet* int_set_combine(IntSet *self, IntSet *other, int_set_op op) {
+    int_set_lock_pair(self, other);
+
+    int_set_pair *pairs = (int_set_pair*) malloc(MAX(self->count + other->count, 1) * sizeof(int_set_pair));
+    size_t n = 0, i = 0, j = 0;
+
+    if (!pairs)
+        throw_memory_allocation_error();
+
+    while (i < self->count || j < other->count) {
+        const int_set_container *a = i < self->count ? &self->chunks[i] : NULL;
+        const int_set_container *b = j < other->count ? &other->chunks[j] : NULL;
+
+        if (a && b && a->key == b->key) {
+            i++;
+            j++;
+        } else if (a && (!b || a->key < b->key)) {
+            b = NULL;
+            i++;
+        } else {
+            a = NULL;
+            j++;
+        }
+
+        if ((op == INT_SET_INTERSECTION && (!a || !b)) || (op == INT_SET_DIFFERENCE && !a))
+            continue;
+
+        pairs[n].a = a;
+        pairs[n].b = b;
+        n++;
+    }
+
+    size_t threads = 1;
+
+    if (self->cardinality + other->cardinality >= INT_SET_PARALLEL_THRESHOLD) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = MIN(MIN((size_t) MAX(cpus, 1L), (size_t) INT_SET_MAX_THREADS), MAX(n, (size_t) 1));
+    }
+
+    int_set_combine_job jobs[INT_SET_MAX_THREADS];
+    pthread_t ids[INT_SET_MAX_THREADS];
+    bool spawned[INT_SET_MAX_THREADS];
+
+    for (size_t t=0; t<threads; ++t) {
+        jobs[t] = (int_set_combine_job) { pairs, n * t / threads, n * (t + 1) / threads, op };
+        spawned[t] = t > 0 && pthread_create(&ids[t], NULL, int_set_combine_worker, &jobs[t]) == 0;
+    }
+
+    for (size_t t=0; t<threads; ++t) {
+        if (!spawned[t])
+            int_set_combine_worker(&jobs[t]);
+    }
+
+    for (size_t t=1; t<threads; ++t) {
+        if (spawned[t])
+            pthread_join(ids[t], NULL);
+    }
+
+    int_set_unlock_pair(self, other);
+
+    IntSet *result = New_IntSet();
+
+    result->chunks = (int_set_container*) malloc(MAX(n, 1) * sizeof(int_set_container));
+    result->capacity = MAX(n, 1);
+
+    if (!result->chunks)
+        throw_memory_allocation_error();
+
+    for (size_t p=0; p<n; ++p) {
+        if (pairs[p].out.cardinality == 0) {
+            free(pairs[p].out.data);
+            continue;
+        }
+
+        result->chunks[result->count++] = pairs[p].out;
+        result->cardinality += pairs[p].out.cardinality;
+    }
+
+    free(pairs);
+
+    return result;
+}
+
+
+static IntSet* int_set_unite(IntSet *self, IntSet *other) {
+    return int_set_combine(self, other, INT_SET_UNION);
+}
+
+
+static IntSet* int_set_intersect(IntSet *self, IntSet *other) {
+    return int_set_combine(self, other, INT_SET_INTERSECTION);
+}
+
+
+static IntSet* int_set_subtract(IntSet *self, IntSet *other) {
+    return int_set_combine(self, other, INT_SET_DIFFERENCE);
+}
+
+
+static bool int_set_is_subset(IntSet *self, IntSet *other) {
+    int_set_lock_pair(self, other);
+
+    bool subset = self->cardinality <= other->cardinality;
+    size_t j = 0;
+
+    for (size_t i=0; subset && i<self->count; ++i) {
+        const int_set_container *a = &self->chunks[i];
+
+        while (j < other->count && other->chunks[j].key < a->key)
+            j++;
+
+        if (j == other->count || other->chunks[j].key != a->key || a->cardinality > other->chunks[j].cardinality) {
+            subset = false;
+            break;
+        }
+
+        int_set_container rest;
+        int_set_container_combine(a, &other->chunks[j], INT_SET_DIFFERENCE, &rest);
+
+        subset = rest.cardinality == 0;
+        free(rest.data);
+    }
+
+    int_set_unlock_pair(self, other);
+
+    return subset;
+}
+
+
+static void int_set_free(IntSet *self) {
+    WRITE_LOCK(self->lock);
+
+    for (size_t i=0; i<self->count; ++i)
+        free(self->chunks[i].data);
+
+    free(self->chunks);
+
+    RW_UNLOCK(self->lock);
+    pthread_rwlock_destroy(&self->lock);
+
+    free(self);
+}
@@ -2,11 +2,13 @@
 
 
 #include "./internals.h"
+#include "./Pool.h"
 
 
 typedef struct list_node {
     void *data;
     size_t type_size;
+    bool adopted;
 
     struct list_node *next;
     struct list_node *prev;
@@ -20,12 +22,19 @@ typedef struct List {
     list_node *tail;
     size_t len;
 
+    node_pool pool;
+    bool arena;
+    size_t adopted_count;
+
+    void (*destructor)(void *data);
+
     pthread_mutex_t mutex;
     pthread_mutexattr_t mutex_attr;
 
     bool (*is_empty)(struct List *self);
     void (*print)(struct List *self);
     void (*append_at)(struct List *self, void *data, size_t type_size, size_t index);
+    void (*adopt_at)(struct List *self, void *data, size_t type_size, size_t index);
     void (*modify_at)(struct List *self, void *data, size_t type_size, size_t index);
     void* (*get_at)(struct List *self, size_t index);
     void (*reverse)(struct List *self);
@@ -37,15 +46,21 @@ typedef struct List {
     void* (*dequeue)(struct List *self);
     bool (*lookup)(struct List *self, void *data, size_t type_size);
     size_t (*count_occurrences)(struct List *self, void *data, size_t type_size);
+    void (*set_destructor)(struct List *self, void (*destructor)(void *data));
+    bool (*use_arena)(struct List *self);
     void (*free)(struct List *self);
 } List;
 
 
 List* New_List();
-static list_node* init_list_node(void *data, size_t type_size);
+static list_node* init_list_node(List *self, void *data, size_t type_size, bool adopted);
+static inline void* list_copy_data(List *self, const void *data, size_t type_size);
+static inline void list_release_data(List *self, void *data, bool adopted);
 static bool list_is_empty(List *self);
 static void list_print(List *self);
+static void list_insert_node(List *self, list_node *new_node, size_t index);
 static void list_append_at(List *self, void *data, size_t type_size, size_t index);
+static void list_adopt_at(List *self, void *data, size_t type_size, size_t index);
 static void list_modify_at(List *self, void *data, size_t type_size, size_t index);
 static void* list_get_at(List *self, size_t index);
 static void list_reverse(List *self);
@@ -57,6 +72,8 @@ static inline void list_enqueue(List *self, void *data, size_t type_size);
 static inline void* list_dequeue(List *self);
 static bool list_lookup(List *self, void *data, size_t type_size);
 static size_t list_count_occurrences(struct List *self, void *data, size_t type_size);
+static void list_set_destructor(List *self, void (*destructor)(void *data));
+static bool list_use_arena(List *self);
 static void list_free(List *self);
 
 
@@ -71,6 +88,11 @@ List* New_List() {
     self->len = 0;
     self->head = NULL;
     self->tail = NULL;
+    self->arena = false;
+    self->adopted_count = 0;
+    self->destructor = free;
+
+    node_pool_init(&self->pool, sizeof(list_node));
 
     pthread_mutexattr_init(&self->mutex_attr);
     pthread_mutexattr_settype(&self->mutex_attr, PTHREAD_MUTEX_RECURSIVE);
@@ -82,6 +104,7 @@ List* New_List() {
     self->is_empty = list_is_empty;
     self->print = list_print;
     self->append_at = list_append_at;
+    self->adopt_at = list_adopt_at;
     self->modify_at = list_modify_at;
     self->get_at = list_get_at;
     self->reverse = list_reverse;
@@ -93,20 +116,23 @@ List* New_List() {
     self->dequeue = list_dequeue;
     self->lookup = list_lookup;
     self->count_occurrences = list_count_occurrences;
+    self->set_destructor = list_set_destructor;
+    self->use_arena = list_use_arena;
     self->free = list_free;
 
     return self;
 }
 
 
-static list_node* init_list_node(void *data, size_t type_size) {
-    list_node *node = (list_node*) malloc(sizeof(list_node));
+static list_node* init_list_node(List *self, void *data, size_t type_size, bool adopted) {
+    list_node *node = (list_node*) node_pool_alloc(&self->pool);
 
-    if (!node)
-        throw_memory_allocation_error();
+    if (adopted)
+        self->adopted_count++;
 
     node->data = data;
     node->type_size = type_size;
+    node->adopted = adopted;
     node->next = NULL;
     node->prev = NULL;
     
@@ -114,6 +140,27 @@ static list_node* init_list_node(void *data, size_t type_size) {
 }
 
 
+static inline void* list_copy_data(List *self, const void *data, size_t type_size) {
+    if (!self->arena || !data || type_size == 0)
+        return copy_from_void_ptr(data, type_size);
+
+    return memcpy(node_pool_alloc_bytes(&self->pool, type_size), data, type_size);
+}
+
+
+static inline void list_release_data(List *self, void *data, bool adopted) {
+    if (!data)
+        return;
+
+    if (adopted) {
+        self->adopted_count--;
+        self->destructor(data);
+    } else if (!self->arena) {
+        free(data);
+    }
+}
+
+
 static bool list_is_empty(List *self) {
     LOCK(self->mutex);
 
@@ -146,16 +193,7 @@ static void list_print(List *self) {
 }
 
 
-static void list_append_at(List *self, void *data, size_t type_size, size_t index) {
-    LOCK(self->mutex);
-
-    if (index > self->len) {
-        fprintf(stderr, "Appending List element out of bound\n");
-        exit(EXIT_FAILURE);
-    }
-
-    list_node *new_node = init_list_node(copy_from_void_ptr(data, type_size), type_size);
-
+static void list_insert_node(List *self, list_node *new_node, size_t index) {
     if (index == 0) {
         new_node->prev = NULL;
         new_node->next = self->head;
@@ -195,6 +233,32 @@ static void list_append_at(List *self, void *data, size_t type_size, size_t inde
     }
 
     self->len++;
+}
+
+
+static void list_append_at(List *self, void *data, size_t type_size, size_t index) {
+    LOCK(self->mutex);
+
+    if (index > self->len) {
+        fprintf(stderr, "Appending List element out of bound\n");
+        exit(EXIT_FAILURE);
+    }
+
+    list_insert_node(self, init_list_node(self, list_copy_data(self, data, type_size), type_size, false), index);
+
+    UNLOCK(self->mutex);
+}
+
+
+static void list_adopt_at(List *self, void *data, size_t type_size, size_t index) {
+    LOCK(self->mutex);
+
+    if (index > self->len) {
+        fprintf(stderr, "Appending List element out of bound\n");
+        exit(EXIT_FAILURE);
+    }
+
+    list_insert_node(self, init_list_node(self, data, type_size, true), index);
 
     UNLOCK(self->mutex);
 }
@@ -226,8 +290,10 @@ static void list_modify_at(List *self, void *data, size_t type_size, size_t inde
         }
     }
 
-    free(current_node->data);
-    current_node->data = copy_from_void_ptr(data, type_size);
+    list_release_data(self, current_node->data, current_node->adopted);
+    current_node->data = list_copy_data(self, data, type_size);
+    current_node->type_size = type_size;
+    current_node->adopted = false;
 
     UNLOCK(self->mutex);
 }
@@ -365,10 +431,14 @@ static void* list_delete_at(List *self, size_t index) {
 
     self->len--;
 
-    void *ret = copy_from_void_ptr(to_delete->data, to_delete->type_size);
-    
-    free(to_delete->data);
-    free(to_delete);
+    void *ret = to_delete->data;
+
+    if (to_delete->adopted)
+        self->adopted_count--;
+    else if (self->arena)
+        ret = copy_from_void_ptr(ret, to_delete->type_size);
+
+    node_pool_release(&self->pool, to_delete);
 
     UNLOCK(self->mutex);
 
@@ -439,11 +509,37 @@ static size_t list_count_occurrences(struct List *self, void *data, size_t type_
 }
 
 
+static void list_set_destructor(List *self, void (*destructor)(void *data)) {
+    LOCK(self->mutex);
+
+    self->destructor = destructor;
+
+    UNLOCK(self->mutex);
+}
+
+
+static bool list_use_arena(List *self) {
+    LOCK(self->mutex);
+
+    bool res = self->len == 0;
+
+    if (res)
+        self->arena = true;
+
+    UNLOCK(self->mutex);
+
+    return res;
+}
+
+
 static void list_free(List *self) {
     LOCK(self->mutex);
 
-    while (!self->is_empty(self))
-        self->delete_at(self, 0);
+    if (!self->arena || self->adopted_count > 0)
+        for (list_node *current_node=self->head; current_node; current_node=current_node->next)
+            list_release_data(self, current_node->data, current_node->adopted);
+
+    node_pool_destroy(&self->pool);
 
     UNLOCK(self->mutex);
     pthread_mutex_destroy(&self->mutex);
@@ -0,0 +1,147 @@
+#pragma once
+
+
+#include "./internals.h"
+
+
+#define POOL_SLAB_BYTES (64 * 1024)
+#define POOL_ALIGN 16
+#define POOL_CACHE_LINE 64
+
+
+typedef struct pool_slab {
+    struct pool_slab *next;
+    size_t size;
+    size_t used;
+} __attribute__((aligned(POOL_CACHE_LINE))) pool_slab;
+
+
+typedef struct node_pool {
+    size_t object_size;
+    size_t object_align;
+
+    void *free_list;
+    char *cursor;
+    char *end;
+
+    pool_slab *current;
+    pool_slab *slabs;
+} node_pool;
+
+
+char node_pool_dead;
+
+
+static inline size_t pool_round(size_t size, size_t align);
+static inline void node_pool_init(node_pool *pool, size_t object_size);
+static pool_slab* node_pool_new_slab(node_pool *pool, size_t size, size_t used);
+static void* node_pool_bump(node_pool *pool, size_t size, size_t align);
+static inline void* node_pool_alloc_bytes(node_pool *pool, size_t size);
+static inline void* node_pool_alloc(node_pool *pool);
+static inline void* node_pool_alloc_array(node_pool *pool, size_t n);
+static inline void node_pool_release(node_pool *pool, void *ptr);
+static void node_pool_foreach(node_pool *pool, void (*func)(void *ctx, void *object), void *ctx);
+static void node_pool_destroy(node_pool *pool);
+
+
+static inline size_t pool_round(size_t size, size_t align) {
+    return (size + align - 1) & ~(align - 1);
+}
+
+
+static inline void node_pool_init(node_pool *pool, size_t object_size) {
+    pool->object_size = pool_round(MAX(object_size, 2 * sizeof(void*)), sizeof(void*));
+    pool->object_align = MIN(pool->object_size & -pool->object_size, POOL_CACHE_LINE);
+    pool->free_list = NULL;
+    pool->cursor = NULL;
+    pool->end = NULL;
+    pool->current = NULL;
+    pool->slabs = NULL;
+}
+
+
+static pool_slab* node_pool_new_slab(node_pool *pool, size_t size, size_t used) {
+    pool_slab *slab;
+
+    if (posix_memalign((void**) &slab, POOL_CACHE_LINE, sizeof(pool_slab) + size) != 0)
+        throw_memory_allocation_error();
+
+    slab->size = size;
+    slab->used = used;
+    slab->next = pool->slabs;
+    pool->slabs = slab;
+
+    return slab;
+}
+
+
+static void* node_pool_bump(node_pool *pool, size_t size, size_t align) {
+    if (size > POOL_SLAB_BYTES / 4)
+        return node_pool_new_slab(pool, size, size) + 1;
+
+    char *ptr = pool->cursor ? (char*) pool_round((uintptr_t) pool->cursor, align) : NULL;
+
+    if (!ptr || (size_t) (pool->end - ptr) < size) {
+        pool->current = node_pool_new_slab(pool, POOL_SLAB_BYTES, 0);
+        ptr = (char*) (pool->current + 1);
+        pool->end = ptr + POOL_SLAB_BYTES;
+    }
+
+    pool->cursor = ptr + size;
+    pool->current->used = pool->cursor - (char*) (pool->current + 1);
+
+    return ptr;
+}
+
+
+static inline void* node_pool_alloc_bytes(node_pool *pool, size_t size) {
+    return node_pool_bump(pool, pool_round(size, POOL_ALIGN), POOL_ALIGN);
+}
+
+
+static inline void* node_pool_alloc(node_pool *pool) {
+    void *ptr = pool->free_list;
+
+    if (!ptr)
+        return node_pool_bump(pool, pool->object_size, pool->object_align);
+
+    pool->free_list = *(void**) ptr;
+
+    return ptr;
+}
+
+
+static inline void* node_pool_alloc_array(node_pool *pool, size_t n) {
+    return n > 0 ? node_pool_new_slab(pool, n * pool->object_size, n * pool->object_size) + 1 : NULL;
+}
+
+
+static inline void node_pool_release(node_pool *pool, void *ptr) {
+    *(void**) ptr = pool->free_list;
+    pool->free_list = ptr;
+}
+
+
+static void node_pool_foreach(node_pool *pool, void (*func)(void *ctx, void *object), void *ctx) {
+    for (void *ptr=pool->free_list; ptr; ptr=*(void**) ptr)
+        ((void**) ptr)[1] = &node_pool_dead;
+
+    for (pool_slab *slab=pool->slabs; slab; slab=slab->next) {
+        char *begin = (char*) (slab + 1);
+
+        for (char *object=begin; object + pool->object_size <= begin + slab->used; object+=pool->object_size)
+            if (((void**) object)[1] != &node_pool_dead)
+                func(ctx, object);
+    }
+}
+
+
+static void node_pool_destroy(node_pool *pool) {
+    while (pool->slabs) {
+        pool_slab *next = pool->slabs->next;
+        free(pool->slabs);
+        pool->slabs = next;
+    }
+
+    node_pool_init(pool, pool->object_size);
+}
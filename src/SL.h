@@ -1,9 +1,20 @@
 #pragma once
 
+// Ownership: adopt*(..., data, type_size, ...) hands the container a heap pointer of type_size bytes
+// instead of a copy. delete* and overwrites release it with the destructor set by set_destructor
+// (free by default). steal*, List delete_at/pop/dequeue return it and the caller frees it.
+
 #include "./internals.h"
+#include "./Hash.h"
+#include "./Pool.h"
 
 #include "./List.h"
 #include "./AVL_Tree.h"
+#include "./BPlusTree.h"
 #include "./HashTable.h"
+#include "./ConcurrentHashTable.h"
+#include "./HashTableSnapshot.h"
+#include "./Cache.h"
 #include "./Set.h"
+#include "./IntSet.h"
 #include "./ArrayList.h"
\ No newline at end of file
@@ -2,59 +2,81 @@
 
 
 #include "./internals.h"
-#include "./AVL_Tree.h"
+#include "./HashTable.h"
 
 
-char* pointed_to_hex_string(void* data, size_t size) {
-    if (!data || size == 0)
-        return NULL;
+#define SET_PARALLEL_THRESHOLD (1 << 16)
+#define SET_MAX_THREADS 16
+#define SET_SKEW 8
 
-    const unsigned char* bytes = (unsigned char*) data;
-
-    char* hex_str = (char*) malloc(size*2 + 1);
-    
-    if (!hex_str)
-        throw_memory_allocation_error();
-    
-    for (size_t i = 0; i < size; ++i)
-        sprintf(&hex_str[i * 2], "%02X", bytes[i]);
-
-    hex_str[size * 2] = '\0';
-
-    return hex_str;
-}
 
+typedef struct set_probe_job {
+    ht_engine *source;
+    ht_engine *probe;
+    size_t lo;
+    size_t hi;
+    bool keep_present;
+    bool *stop;
 
-int get_key_from_data(void *data, size_t size) {
-    char *hex_string = pointed_to_hex_string(data, size);
-    int key = fnv1a_64(hex_string, strlen(hex_string));
-
-    free(hex_string);
-
-    return key;
-}
+    size_t *kept;
+    size_t kept_len;
+    size_t kept_capacity;
+} set_probe_job;
 
 
 typedef struct Set {
     struct Set *self;
 
-    AVL_Tree *tree;
+    ht_engine engine;
 
     pthread_mutex_t mutex;
     pthread_mutexattr_t mutex_attr;
 
     void (*insert)(struct Set *self, void *data, size_t type_size);
+    void (*adopt)(struct Set *self, void *data, size_t type_size);
     void (*delete)(struct Set *self, void *data, size_t type_size);
+    void* (*steal)(struct Set *self, void *data, size_t type_size);
     bool (*lookup)(struct Set *self, void *data, size_t type_size);
-    void (*free)(struct Set *self);    
+    void* (*get)(struct Set *self, void *data, size_t type_size);
+    size_t (*size)(struct Set *self);
+    void (*foreach)(struct Set *self, void (*func)(void *data, size_t type_size, va_list args), ...);
+    struct Set* (*unite)(struct Set *self, struct Set *other);
+    struct Set* (*intersect)(struct Set *self, struct Set *other);
+    struct Set* (*subtract)(struct Set *self, struct Set *other);
+    bool (*is_subset)(struct Set *self, struct Set *other);
+    void (*pin)(struct Set *self);
+    void (*unpin)(struct Set *self);
+    void (*set_destructor)(struct Set *self, void (*destructor)(void *data));
+    void (*free)(struct Set *self);
 } Set;
 
 
-Set* New_Set(); 
+Set* New_Set();
+static inline void* set_element(const Entry *entry);
 static inline void set_insert(Set *self, void *data, size_t type_size);
+static inline void set_adopt(Set *self, void *data, size_t type_size);
 static inline void set_delete(Set *self, void *data, size_t type_size);
+static void* set_steal(Set *self, void *data, size_t type_size);
 static inline bool set_lookup(Set *self, void *data, size_t type_size);
-static void set_free( Set *self);    
+static inline void* set_get(Set *self, void *data, size_t type_size);
+static size_t set_size(Set *self);
+static void set_foreach(Set *self, void (*func)(void *data, size_t type_size, va_list args), ...);
+static void set_lock_pair(Set *a, Set *b);
+static void set_unlock_pair(Set *a, Set *b);
+static inline uint64_t set_rehash(const ht_engine *from, const ht_engine *to, const Entry *entry);
+static void* set_probe_worker(void *arg);
+static set_probe_job* set_probe(Set *source, Set *probe, bool keep_present, bool stop_early, size_t *count);
+static void set_probe_release(set_probe_job *jobs, size_t count);
+static void set_insert_kept(Set *result, Set *source, set_probe_job *jobs, size_t count);
+static Set* set_copy_locked(Set *source);
+static Set* set_unite(Set *self, Set *other);
+static Set* set_intersect(Set *self, Set *other);
+static Set* set_subtract(Set *self, Set *other);
+static bool set_is_subset(Set *self, Set *other);
+static inline void set_pin(Set *self);
+static inline void set_unpin(Set *self);
+static inline void set_set_destructor(Set *self, void (*destructor)(void *data));
+static void set_free( Set *self);
 
 
 Set* New_Set() {
@@ -64,8 +86,8 @@ Set* New_Set() {
         throw_memory_allocation_error();
 
     self->self = self;
-    
-    self->tree = New_AVL_Tree();
+
+    ht_engine_init(&self->engine);
 
     pthread_mutexattr_init(&self->mutex_attr);
     pthread_mutexattr_settype(&self->mutex_attr, PTHREAD_MUTEX_RECURSIVE);
@@ -75,51 +97,421 @@ Set* New_Set() {
     pthread_mutexattr_destroy(&self->mutex_attr);
 
     self->insert = set_insert;
+    self->adopt = set_adopt;
     self->delete = set_delete;
+    self->steal = set_steal;
     self->lookup = set_lookup;
+    self->get = set_get;
+    self->size = set_size;
+    self->foreach = set_foreach;
+    self->unite = set_unite;
+    self->intersect = set_intersect;
+    self->subtract = set_subtract;
+    self->is_subset = set_is_subset;
+    self->pin = set_pin;
+    self->unpin = set_unpin;
+    self->set_destructor = set_set_destructor;
     self->free = set_free;
 
     return self;
 }
 
 
+static inline void* set_element(const Entry *entry) {
+    void *data = __atomic_load_n(&entry->data, __ATOMIC_ACQUIRE);
+    return data ? data : __atomic_load_n(&entry->key, __ATOMIC_ACQUIRE);
+}
+
+
 static inline void set_insert(Set *self, void *data, size_t type_size) {
+    uint64_t hash = ht_engine_hash(&self->engine, data, type_size);
+
     LOCK(self->mutex);
 
-    self->tree->insert(self->tree, get_key_from_data(data, type_size), data, type_size);
-    
+    if (!ht_engine_find(&self->engine, data, type_size, hash))
+        ht_engine_insert(&self->engine, data, type_size, hash, NULL, 0, false, false);
+
+    UNLOCK(self->mutex);
+}
+
+
+static inline void set_adopt(Set *self, void *data, size_t type_size) {
+    uint64_t hash = ht_engine_hash(&self->engine, data, type_size);
+
+    LOCK(self->mutex);
+
+    ht_engine_insert(&self->engine, data, type_size, hash, data, type_size, true, true);
+
     UNLOCK(self->mutex);
 }
 
 
 static inline void set_delete(Set *self, void *data, size_t type_size) {
+    uint64_t hash = ht_engine_hash(&self->engine, data, type_size);
+
     LOCK(self->mutex);
-    
-    self->tree->delete(self->tree, get_key_from_data(data, type_size));
-    
+
+    ht_engine_erase(&self->engine, data, type_size, hash, NULL);
+
     UNLOCK(self->mutex);
 }
 
 
+static void* set_steal(Set *self, void *data, size_t type_size) {
+    uint64_t hash = ht_engine_hash(&self->engine, data, type_size);
+
+    LOCK(self->mutex);
+
+    void *res = NULL;
+    void *stolen = NULL;
+    Entry *entry = ht_engine_find(&self->engine, data, type_size, hash);
+
+    if (!entry)
+        goto un;
+
+    if (!entry->data)
+        res = copy_from_void_ptr(entry->key, entry->key_len);
+
+    ht_engine_erase(&self->engine, data, type_size, hash, &stolen);
+
+    if (stolen)
+        res = stolen;
+
+    un:
+        UNLOCK(self->mutex);
+
+    return res;
+}
+
+
 static inline bool set_lookup(Set *self, void *data, size_t type_size) {
+    uint64_t hash = ht_engine_hash(&self->engine, data, type_size);
+
+    epoch_enter();
+
+    bool res = ht_engine_find(&self->engine, data, type_size, hash) != NULL;
+
+    epoch_exit();
+
+    return res;
+}
+
+
+static inline void* set_get(Set *self, void *data, size_t type_size) {
+    uint64_t hash = ht_engine_hash(&self->engine, data, type_size);
+
+    epoch_enter();
+
+    Entry *entry = ht_engine_find(&self->engine, data, type_size, hash);
+    void *res = entry ? set_element(entry) : NULL;
+
+    epoch_exit();
+
+    return res;
+}
+
+
+static size_t set_size(Set *self) {
     LOCK(self->mutex);
 
-    bool res =  self->tree->lookup(self->tree, get_key_from_data(data, type_size)) != NULL;
-    
+    size_t size = self->engine.size;
+
     UNLOCK(self->mutex);
 
-    return res;
+    return size;
+}
+
+
+static void set_foreach(Set *self, void (*func)(void *data, size_t type_size, va_list args), ...) {
+    LOCK(self->mutex);
+
+    va_list args;
+    va_start(args, func);
+
+    for (size_t i=0; i<self->engine.entries_len; ++i) {
+        Entry *entry = ht_engine_entry(&self->engine, i);
+
+        if (!entry->live)
+            continue;
+
+        va_list args_copy;
+        va_copy(args_copy, args);
+        func(set_element(entry), entry->key_len, args_copy);
+        va_end(args_copy);
+    }
+
+    va_end(args);
+
+    UNLOCK(self->mutex);
+}
+
+
+static void set_lock_pair(Set *a, Set *b) {
+    if ((uintptr_t) a > (uintptr_t) b) {
+        Set *tmp = a;
+        a = b;
+        b = tmp;
+    }
+
+    LOCK(a->mutex);
+
+    if (a != b)
+        LOCK(b->mutex);
+}
+
+
+static void set_unlock_pair(Set *a, Set *b) {
+    if (a != b)
+        UNLOCK(b->mutex);
+
+    UNLOCK(a->mutex);
+}
+
+
+static inline uint64_t set_rehash(const ht_engine *from, const ht_engine *to, const Entry *entry) {
+    return from->seed == to->seed ? entry->hash : ht_engine_hash(to, entry->key, entry->key_len);
+}
+
+
+static void* set_probe_worker(void *arg) {
+    set_probe_job *job = (set_probe_job*) arg;
+
+    for (size_t i=job->lo; i<job->hi; ++i) {
+        const Entry *entry = ht_engine_entry(job->source, i);
+
+        if (job->stop && __atomic_load_n(job->stop, __ATOMIC_RELAXED))
+            break;
+
+        if (!entry->live)
+            continue;
+
+        bool present = ht_engine_find(job->probe, entry->key, entry->key_len, set_rehash(job->source, job->probe, entry)) != NULL;
+
+        if (present != job->keep_present)
+            continue;
+
+        if (job->kept_len == job->kept_capacity) {
+            size_t new_capacity = job->kept_capacity ? job->kept_capacity * 2 : 64;
+            size_t *new_kept = (size_t*) realloc(job->kept, new_capacity * sizeof(size_t));
+
+            if (!new_kept)
+                throw_memory_allocation_error();
+
+            job->kept = new_kept;
+            job->kept_capacity = new_capacity;
+        }
+
+        job->kept[job->kept_len++] = i;
+
+        if (job->stop)
+            __atomic_store_n(job->stop, true, __ATOMIC_RELAXED);
+    }
+
+    return NULL;
+}
+
+
+static set_probe_job* set_probe(Set *source, Set *probe, bool keep_present, bool stop_early, size_t *count) {
+    size_t n = source->engine.entries_len;
+    size_t threads = 1;
+
+    if (n >= 2 * SET_PARALLEL_THRESHOLD) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = MIN(MIN((size_t) MAX(cpus, 1L), (size_t) SET_MAX_THREADS), n / SET_PARALLEL_THRESHOLD);
+    }
+
+    set_probe_job *jobs = (set_probe_job*) calloc(threads, sizeof(set_probe_job));
+    pthread_t *ids = (pthread_t*) malloc(threads * sizeof(pthread_t));
+    bool *spawned = (bool*) calloc(threads, sizeof(bool));
+    bool stop = false;
+
+    if (!jobs || !ids || !spawned)
+        throw_memory_allocation_error();
+
+    for (size_t t=0; t<threads; ++t) {
+        jobs[t].source = &source->engine;
+        jobs[t].probe = &probe->engine;
+        jobs[t].lo = n * t / threads;
+        jobs[t].hi = n * (t + 1) / threads;
+        jobs[t].keep_present = keep_present;
+        jobs[t].stop = stop_early ? &stop : NULL;
+
+        if (t > 0)
+            spawned[t] = pthread_create(&ids[t], NULL, set_probe_worker, &jobs[t]) == 0;
+    }
+
+    set_probe_worker(&jobs[0]);
+
+    for (size_t t=1; t<threads; ++t) {
+        if (spawned[t])
+            pthread_join(ids[t], NULL);
+        else
+            set_probe_worker(&jobs[t]);
+    }
+
+    free(ids);
+    free(spawned);
+
+    *count = threads;
+
+    return jobs;
+}
+
+
+static void set_probe_release(set_probe_job *jobs, size_t count) {
+    for (size_t t=0; t<count; ++t)
+        free(jobs[t].kept);
+
+    free(jobs);
+}
+
+
+static void set_insert_kept(Set *result, Set *source, set_probe_job *jobs, size_t count) {
+    for (size_t t=0; t<count; ++t) {
+        for (size_t i=0; i<jobs[t].kept_len; ++i) {
+            const Entry *entry = ht_engine_entry(&source->engine, jobs[t].kept[i]);
+            ht_engine_insert(&result->engine, entry->key, entry->key_len, set_rehash(&source->engine, &result->engine, entry), NULL, 0, false, false);
+        }
+    }
+}
+
+
+static Set* set_copy_locked(Set *source) {
+    Set *result = New_Set();
+
+    result->engine.seed = source->engine.seed;
+
+    for (size_t i=0; i<source->engine.entries_len; ++i) {
+        const Entry *entry = ht_engine_entry(&source->engine, i);
+
+        if (entry->live)
+            ht_engine_insert(&result->engine, entry->key, entry->key_len, entry->hash, NULL, 0, false, false);
+    }
+
+    return result;
+}
+
+
+static Set* set_unite(Set *self, Set *other) {
+    set_lock_pair(self, other);
+
+    Set *larger = self->engine.size >= other->engine.size ? self : other;
+    Set *smaller = larger == self ? other : self;
+    Set *result = set_copy_locked(larger);
+
+    size_t count;
+    set_probe_job *jobs = set_probe(smaller, larger, false, false, &count);
+
+    set_insert_kept(result, smaller, jobs, count);
+    set_probe_release(jobs, count);
+
+    set_unlock_pair(self, other);
+
+    return result;
+}
+
+
+static Set* set_intersect(Set *self, Set *other) {
+    set_lock_pair(self, other);
+
+    Set *smaller = self->engine.size <= other->engine.size ? self : other;
+    Set *larger = smaller == self ? other : self;
+    Set *result = New_Set();
+
+    result->engine.seed = smaller->engine.seed;
+
+    size_t count;
+    set_probe_job *jobs = set_probe(smaller, larger, true, false, &count);
+
+    set_insert_kept(result, smaller, jobs, count);
+    set_probe_release(jobs, count);
+
+    set_unlock_pair(self, other);
+
+    return result;
+}
+
+
+static Set* set_subtract(Set *self, Set *other) {
+    set_lock_pair(self, other);
+
+    Set *result;
+
+    if (other->engine.size * SET_SKEW < self->engine.size) {
+        result = set_copy_locked(self);
+
+        for (size_t i=0; i<other->engine.entries_len; ++i) {
+            const Entry *entry = ht_engine_entry(&other->engine, i);
+
+            if (entry->live)
+                ht_engine_erase(&result->engine, entry->key, entry->key_len, set_rehash(&other->engine, &result->engine, entry), NULL);
+        }
+    } else {
+        result = New_Set();
+        result->engine.seed = self->engine.seed;
+
+        size_t count;
+        set_probe_job *jobs = set_probe(self, other, false, false, &count);
+
+        set_insert_kept(result, self, jobs, count);
+        set_probe_release(jobs, count);
+    }
+
+    set_unlock_pair(self, other);
+
+    return result;
+}
+
+
+static bool set_is_subset(Set *self, Set *other) {
+    set_lock_pair(self, other);
+
+    bool subset = self->engine.size <= other->engine.size;
+
+    if (subset) {
+        size_t count;
+        set_probe_job *jobs = set_probe(self, other, false, true, &count);
+
+        for (size_t t=0; t<count; ++t)
+            subset = subset && jobs[t].kept_len == 0;
+
+        set_probe_release(jobs, count);
+    }
+
+    set_unlock_pair(self, other);
+
+    return subset;
+}
+
+
+static inline void set_pin(Set *self) {
+    (void) self;
+    epoch_enter();
+}
+
+
+static inline void set_unpin(Set *self) {
+    (void) self;
+    epoch_exit();
+}
+
+
+static inline void set_set_destructor(Set *self, void (*destructor)(void *data)) {
+    LOCK(self->mutex);
+
+    self->engine.destructor = destructor;
+
+    UNLOCK(self->mutex);
 }
 
 
 static void set_free(Set *self) {
     LOCK(self->mutex);
 
-    self->tree->free(self->tree);
-    
+    ht_engine_destroy(&self->engine);
+
     UNLOCK(self->mutex);
     pthread_mutex_destroy(&self->mutex);
 
     free(self);
 }
-
@@ -8,10 +8,18 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
+#include <limits.h>
 #include <inttypes.h>
 #include <pthread.h>
+#include <sched.h>
 #include <sys/types.h>
 #include <stdarg.h>
+#include <time.h>
+#include <sys/random.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 
 #define MAX(a,b) ((a) > (b) ? a : b)
@@ -20,6 +28,9 @@
 
 #define LOCK(m) pthread_mutex_lock(&m)
 #define UNLOCK(m) pthread_mutex_unlock(&m)
+#define READ_LOCK(l) pthread_rwlock_rdlock(&l)
+#define WRITE_LOCK(l) pthread_rwlock_wrlock(&l)
+#define RW_UNLOCK(l) pthread_rwlock_unlock(&l)
 
 
 extern char* strdup(const char*);
@@ -46,6 +57,14 @@ static inline void* copy_from_void_ptr(const void *src, size_t type_size) {
 }
 
 
+static inline void release_data(void *data, bool adopted, void (*destructor)(void *data)) {
+    if (adopted)
+        destructor(data);
+    else
+        free(data);
+}
+
+
 static inline bool compare_void_ptr(const void *ptr1, const void *ptr2, size_t type_size1, size_t type_size2) {
     return  (type_size1 == type_size2) && (memcmp(ptr1, ptr2, type_size1) == 0);
 }
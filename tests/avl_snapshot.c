@@ -0,0 +1,97 @@
+#include "../src/SL.h"
+
+#include <assert.h>
+
+
+#define KEYS 5000
+
+
+static void sum_key(int64_t key, void *data, va_list args) {
+    int64_t *sum = va_arg(args, int64_t*);
+
+    assert(*(int64_t*) data == key);
+    *sum += key;
+}
+
+
+static void check_snapshot_isolation() {
+    AVL_Tree *tree = New_AVL_Tree();
+    int64_t sum = 0;
+
+    assert(tree->use_persistent(tree));
+
+    for (int64_t key = 0; key < KEYS; key += 2)
+        tree->insert(tree, key, &key, sizeof(key));
+
+    AVLSnapshot *snapshot = tree->snapshot(tree);
+
+    for (int64_t key = 1; key < KEYS; key += 2)
+        tree->insert(tree, key, &key, sizeof(key));
+    for (int64_t key = 0; key < KEYS; key += 4)
+        tree->delete(tree, key);
+
+    int64_t minus_one = -1;
+    tree->insert(tree, 2, &minus_one, sizeof(minus_one));
+
+    assert(snapshot->size(snapshot) == KEYS / 2);
+    assert(snapshot->lookup(snapshot, 1) == NULL);
+    assert(*(int64_t*) snapshot->lookup(snapshot, 2)->data == 2);
+    assert(snapshot->select(snapshot, 10)->key == 20);
+    assert(snapshot->rank(snapshot, 20) == 10);
+
+    snapshot->range(snapshot, INT64_MIN, INT64_MAX, sum_key, &sum);
+    assert(sum == (int64_t) (KEYS / 2) * (KEYS / 2 - 1));
+
+    assert(tree->size(tree) == KEYS - KEYS / 4);
+    assert(tree->lookup_node(tree, 0) == NULL);
+    assert(*(int64_t*) tree->lookup_node(tree, 2)->data == -1);
+
+    snapshot->free(snapshot);
+    tree->free(tree);
+}
+
+
+static void check_cursor(bool persistent) {
+    AVL_Tree *tree = New_AVL_Tree();
+    AVLCursor cursor = AVL_CURSOR_INIT;
+    int64_t expected = 0;
+
+    if (persistent)
+        assert(tree->use_persistent(tree));
+
+    for (int64_t key = KEYS - 1; key >= 0; --key)
+        tree->insert(tree, key * 3, &key, sizeof(key));
+
+    for (tree_node *node = tree->cursor_first(tree, &cursor); node != NULL; node = tree->cursor_next(tree, &cursor)) {
+        assert(node->key == expected * 3);
+        expected++;
+
+        // Writes behind the cursor must not disturb the rest of the walk.
+        if (node->key % 300 == 0)
+            tree->delete(tree, node->key);
+    }
+    assert(expected == KEYS);
+
+    for (tree_node *node = tree->cursor_last(tree, &cursor); node != NULL; node = tree->cursor_prev(tree, &cursor)) {
+        do expected--; while (expected * 3 % 300 == 0);
+        assert(node->key == expected * 3);
+    }
+
+    tree_node *node = tree->cursor_seek(tree, &cursor, 301);
+    assert(node != NULL && node->key == 303);
+    node = tree->cursor_prev(tree, &cursor);
+    assert(node != NULL && node->key == 297);
+
+    tree->cursor_close(tree, &cursor);
+    tree->free(tree);
+}
+
+
+int main() {
+    check_snapshot_isolation();
+    check_cursor(false);
+    check_cursor(true);
+
+    printf("avl_snapshot: ok\n");
+    return 0;
+}
@@ -0,0 +1,104 @@
+#include "../src/SL.h"
+
+#include <assert.h>
+
+
+static void check_lru_eviction() {
+    Cache *cache = New_Cache(3, 0);
+    char key[64];
+    int value;
+
+    for (value = 0; value < 5; ++value) {
+        sprintf(key, "a-key-long-enough-to-live-outside-the-entry-%d", value);
+        assert(cache->put(cache, key, &value, sizeof(value), CACHE_NO_TTL));
+    }
+
+    assert(cache->size(cache) == 3);
+    assert(cache->get(cache, "a-key-long-enough-to-live-outside-the-entry-0") == NULL);
+    assert(cache->get(cache, "a-key-long-enough-to-live-outside-the-entry-1") == NULL);
+
+    // Touching 2 makes 3 the least recently used entry.
+    assert(cache->touch(cache, "a-key-long-enough-to-live-outside-the-entry-2"));
+    value = 5;
+    cache->put(cache, "five", &value, sizeof(value), CACHE_NO_TTL);
+
+    assert(cache->get(cache, "a-key-long-enough-to-live-outside-the-entry-3") == NULL);
+    assert(*(int*) cache->get(cache, "a-key-long-enough-to-live-outside-the-entry-2") == 2);
+
+    value = 9;
+    cache->put(cache, "five", &value, sizeof(value), CACHE_NO_TTL);
+    assert(*(int*) cache->get(cache, "five") == 9);
+    assert(cache->size(cache) == 3);
+    assert(cache->stats(cache).evictions == 3);
+
+    cache->free(cache);
+}
+
+
+static void check_pin() {
+    Cache *cache = New_Cache(2, 0);
+    char key[32];
+    int value = 1;
+
+    cache->put(cache, "pinned", &value, sizeof(value), CACHE_NO_TTL);
+
+    cache->pin(cache);
+    int *pinned = cache->get(cache, "pinned");
+
+    for (value = 0; value < 100; ++value) {
+        sprintf(key, "other-%d", value);
+        cache->put(cache, key, &value, sizeof(value), CACHE_NO_TTL);
+    }
+
+    assert(*pinned == 1);
+    cache->unpin(cache);
+
+    assert(cache->get(cache, "pinned") == NULL);
+    cache->free(cache);
+}
+
+
+static void check_ttl() {
+    Cache *cache = New_Cache(0, 0);
+    int value = 1;
+
+    cache->put(cache, "short", &value, sizeof(value), 20);
+    cache->put(cache, "forever", &value, sizeof(value), CACHE_NO_TTL);
+    assert(cache->get(cache, "short") != NULL);
+
+    usleep(40 * 1000);
+
+    assert(cache->get(cache, "short") == NULL);
+    assert(cache->get(cache, "forever") != NULL);
+    assert(cache->stats(cache).expirations == 1);
+
+    cache->free(cache);
+}
+
+
+static void check_max_bytes() {
+    Cache *cache = New_Cache(0, 64);
+    char data[100] = {0};
+
+    assert(cache->put(cache, "x", data, 10, CACHE_NO_TTL));
+    assert(cache->put(cache, "y", data, 10, CACHE_NO_TTL));
+
+    // An oversized put is rejected and drops the stale entry under the same key.
+    assert(!cache->put(cache, "x", data, sizeof(data), CACHE_NO_TTL));
+    assert(cache->get(cache, "x") == NULL);
+    assert(cache->get(cache, "y") != NULL);
+    assert(cache->size(cache) == 1);
+
+    cache->free(cache);
+}
+
+
+int main() {
+    check_lru_eviction();
+    check_pin();
+    check_ttl();
+    check_max_bytes();
+
+    printf("cache_eviction: ok\n");
+    return 0;
+}
@@ -0,0 +1,120 @@
+#include "../src/SL.h"
+
+#include <assert.h>
+
+
+#define UNIVERSE (3 * 65536)
+
+
+static IntSet* int_set_from(bool *member, uint32_t step, uint32_t offset, bool optimize) {
+    IntSet *set = New_IntSet();
+
+    for (uint32_t value = offset; value < UNIVERSE; value += step) {
+        set->insert(set, value);
+        member[value] = true;
+    }
+
+    if (optimize)
+        set->optimize(set);
+
+    return set;
+}
+
+
+static void check_matches(IntSet *set, bool (*expected)(bool, bool), const bool *a, const bool *b) {
+    size_t cardinality = 0;
+
+    for (uint32_t value = 0; value < UNIVERSE; ++value) {
+        bool want = expected(a[value], b[value]);
+
+        assert(set->lookup(set, value) == want);
+        cardinality += want;
+    }
+
+    assert(set->size(set) == cardinality);
+}
+
+
+static bool union_of(bool a, bool b) {
+    return a || b;
+}
+
+
+static bool intersection_of(bool a, bool b) {
+    return a && b;
+}
+
+
+static bool difference_of(bool a, bool b) {
+    return a && !b;
+}
+
+
+static void check_algebra(uint32_t step_a, uint32_t step_b, bool optimize) {
+    bool *in_a = calloc(UNIVERSE, sizeof(bool));
+    bool *in_b = calloc(UNIVERSE, sizeof(bool));
+
+    // step 1 fills whole chunks, so optimize turns them into runs; step 3 gives bitmaps, large steps arrays.
+    IntSet *a = int_set_from(in_a, step_a, 0, optimize);
+    IntSet *b = int_set_from(in_b, step_b, 1, optimize);
+
+    IntSet *u = a->unite(a, b);
+    IntSet *i = a->intersect(a, b);
+    IntSet *d = a->subtract(a, b);
+
+    check_matches(u, union_of, in_a, in_b);
+    check_matches(i, intersection_of, in_a, in_b);
+    check_matches(d, difference_of, in_a, in_b);
+
+    assert(i->is_subset(i, a) && i->is_subset(i, b));
+    assert(a->is_subset(a, u) && b->is_subset(b, u));
+    assert(d->is_subset(d, a));
+    assert(a->is_subset(a, a));
+
+    a->free(a);
+    b->free(b);
+    u->free(u);
+    i->free(i);
+    d->free(d);
+    free(in_a);
+    free(in_b);
+}
+
+
+static void check_empty() {
+    IntSet *empty = New_IntSet();
+    IntSet *set = New_IntSet();
+
+    set->insert(set, 7);
+    set->insert(set, 70000);
+
+    IntSet *u = empty->unite(empty, set);
+    IntSet *i = empty->intersect(empty, set);
+
+    assert(u->size(u) == 2 && u->lookup(u, 70000));
+    assert(i->size(i) == 0);
+    assert(empty->is_subset(empty, set));
+    assert(!set->is_subset(set, empty));
+
+    empty->free(empty);
+    set->free(set);
+    u->free(u);
+    i->free(i);
+}
+
+
+int main() {
+    uint32_t steps[] = {1, 3, 1000};
+
+    for (size_t x = 0; x < sizeof(steps) / sizeof(steps[0]); ++x) {
+        for (size_t y = 0; y < sizeof(steps) / sizeof(steps[0]); ++y) {
+            check_algebra(steps[x], steps[y], false);
+            check_algebra(steps[x], steps[y], true);
+        }
+    }
+
+    check_empty();
+
+    printf("int_set_algebra: ok\n");
+    return 0;
+}